@@ -0,0 +1,215 @@
+#include "common/fmplayer_checkpoint.h"
+#include "common/fmplayer_file.h"
+#include "fmdriver/fmdriver.h"
+#include "fmdriver/ppz8.h"
+#include "libopna/opna.h"
+#include "libopna/opnatimer.h"
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  SRATE = 55467,
+  SEEK_FRAMES = 64,
+  // opnatimer.c: TIMERB_BITS
+  TIMERB_MAX_FRAMES = 1<<12,
+};
+
+struct fmplayer_checkpoint {
+  uint32_t timerb_cnt;
+  struct opna_fm fm;
+  struct opna_ssg ssg;
+  struct opna_drum drum;
+  struct opna_adpcm adpcm;
+  struct opna_ssg_resampler resampler;
+  uint64_t generated_frames;
+  uint16_t regs[0x200];
+  struct opna_timer timer;
+  struct fmdriver_work work;
+  struct ppz8_channel ppz8_channel[8];
+  uint8_t ppz8_totalvol;
+  // driver struct, then song data
+  unsigned char driver[];
+};
+
+static struct fmplayer_checkpoint *checkpoint_save(
+    const struct fmplayer_checkpoint_index *ci) {
+  struct fmplayer_checkpoint *cp =
+    malloc(sizeof(*cp) + ci->driversize + ci->datalen);
+  if (!cp) return 0;
+  const struct opna *opna = ci->timer->opna;
+  cp->timerb_cnt = ci->work->timerb_cnt;
+  cp->fm = opna->fm;
+  cp->ssg = opna->ssg;
+  cp->drum = opna->drum;
+  cp->adpcm = opna->adpcm;
+  cp->resampler = opna->resampler;
+  cp->generated_frames = opna->generated_frames;
+  memcpy(cp->regs, opna->regs, sizeof(cp->regs));
+  cp->timer = *ci->timer;
+  cp->work = *ci->work;
+  memcpy(cp->ppz8_channel, ci->ppz8->channel, sizeof(cp->ppz8_channel));
+  cp->ppz8_totalvol = ci->ppz8->totalvol;
+  memcpy(cp->driver, ci->driver, ci->driversize);
+  memcpy(cp->driver + ci->driversize, ci->data, ci->datalen);
+  return cp;
+}
+
+static void checkpoint_restore(
+    const struct fmplayer_checkpoint_index *ci,
+    const struct fmplayer_checkpoint *cp) {
+  struct opna *opna = ci->timer->opna;
+  // masks and pause are user settings, not song state
+  unsigned opnamask = opna_get_mask(opna);
+  bool paused = ci->work->paused;
+  bool status_disabled = ci->work->status_disabled;
+  opna->fm = cp->fm;
+  opna->ssg = cp->ssg;
+  opna->drum = cp->drum;
+  opna->adpcm = cp->adpcm;
+  opna->resampler = cp->resampler;
+  opna->generated_frames = cp->generated_frames;
+  memcpy(opna->regs, cp->regs, sizeof(opna->regs));
+  opna_set_mask(opna, opnamask);
+  *ci->timer = cp->timer;
+  *ci->work = cp->work;
+  ci->work->paused = paused;
+  ci->work->status_disabled = status_disabled;
+  memcpy(ci->ppz8->channel, cp->ppz8_channel, sizeof(cp->ppz8_channel));
+  ci->ppz8->totalvol = cp->ppz8_totalvol;
+  memcpy(ci->driver, cp->driver, ci->driversize);
+  memcpy(ci->data, cp->driver + ci->driversize, ci->datalen);
+  // the saved flags might have been taken by the reader
+#ifdef LIBOPNA_ENABLE_LEVELDATA
+  for (int c = 0; c < 6; c++) leveldata_init(&opna->fm.channel[c].leveldata);
+  for (int c = 0; c < 3; c++) leveldata_init(&opna->resampler.leveldata[c]);
+  for (int d = 0; d < 6; d++) leveldata_init(&opna->drum.drums[d].leveldata);
+  leveldata_init(&opna->adpcm.leveldata);
+  for (int c = 0; c < 8; c++) leveldata_init(&ci->ppz8->channel[c].leveldata);
+#endif
+}
+
+static bool checkpoint_push(struct fmplayer_checkpoint_index *ci) {
+  if (ci->cnt == ci->cap) {
+    size_t newcap = ci->cap ? ci->cap * 2 : 64;
+    struct fmplayer_checkpoint **newcheckpoints =
+      realloc(ci->checkpoints, newcap * sizeof(*newcheckpoints));
+    if (!newcheckpoints) return false;
+    ci->checkpoints = newcheckpoints;
+    ci->cap = newcap;
+  }
+  struct fmplayer_checkpoint *cp = checkpoint_save(ci);
+  if (!cp) return false;
+  ci->checkpoints[ci->cnt++] = cp;
+  return true;
+}
+
+bool fmplayer_checkpoint_init(struct fmplayer_checkpoint_index *ci,
+                              struct fmdriver_work *work,
+                              struct opna_timer *timer,
+                              struct ppz8 *ppz8,
+                              size_t driversize,
+                              void *data, size_t datalen) {
+  ci->work = work;
+  ci->timer = timer;
+  ci->ppz8 = ppz8;
+  ci->driver = work->driver;
+  ci->driversize = driversize;
+  ci->data = data;
+  ci->datalen = datalen;
+  ci->checkpoints = 0;
+  ci->cnt = 0;
+  ci->cap = 0;
+  return checkpoint_push(ci);
+}
+
+bool fmplayer_checkpoint_init_file(struct fmplayer_checkpoint_index *ci,
+                                   struct fmdriver_work *work,
+                                   struct opna_timer *timer,
+                                   struct ppz8 *ppz8,
+                                   struct fmplayer_file *fmfile) {
+  switch (fmfile->type) {
+  case FMPLAYER_FILE_TYPE_PMD:
+    return fmplayer_checkpoint_init(
+      ci, work, timer, ppz8, sizeof(fmfile->driver.pmd),
+      fmfile->driver.pmd.data, fmfile->driver.pmd.datalen);
+  case FMPLAYER_FILE_TYPE_FMP:
+    return fmplayer_checkpoint_init(
+      ci, work, timer, ppz8, sizeof(fmfile->driver.fmp),
+      (void *)fmfile->driver.fmp.data, fmfile->driver.fmp.datalen);
+  }
+  return false;
+}
+
+void fmplayer_checkpoint_deinit(struct fmplayer_checkpoint_index *ci) {
+  for (size_t i = 0; i < ci->cnt; i++) free(ci->checkpoints[i]);
+  free(ci->checkpoints);
+  ci->checkpoints = 0;
+  ci->cnt = 0;
+  ci->cap = 0;
+}
+
+void fmplayer_checkpoint_update(struct fmplayer_checkpoint_index *ci) {
+  // checkpoints are only appended on the first playthrough,
+  // loop_cnt does not depend on the loop analysis of fmplayer_file_load
+  if (!ci->cnt || ci->cnt >= FMPLAYER_CHECKPOINT_MAX) return;
+  if (!ci->work->playing) return;
+  if (ci->work->loop_cnt) return;
+  if (ci->work->timerb_cnt < ci->cnt * FMPLAYER_CHECKPOINT_INTERVAL) return;
+  if (ci->checkpoints[ci->cnt-1]->timerb_cnt >= ci->work->timerb_cnt) return;
+  checkpoint_push(ci);
+}
+
+void fmplayer_checkpoint_build(struct fmplayer_checkpoint_index *ci) {
+  if (!ci->cnt) return;
+  bool status_disabled = ci->work->status_disabled;
+  ci->work->status_disabled = true;
+  // the timer might be stopped
+  uint32_t lasttick = ci->work->timerb_cnt;
+  unsigned idle = 0;
+  while (ci->work->playing && !ci->work->loop_cnt
+         && ci->cnt < FMPLAYER_CHECKPOINT_MAX && idle < TIMERB_MAX_FRAMES) {
+    opna_timer_skip(ci->timer, SEEK_FRAMES);
+    fmplayer_checkpoint_update(ci);
+    if (ci->work->timerb_cnt != lasttick) {
+      lasttick = ci->work->timerb_cnt;
+      idle = 0;
+    } else {
+      idle += SEEK_FRAMES;
+    }
+  }
+  checkpoint_restore(ci, ci->checkpoints[0]);
+  ci->work->status_disabled = status_disabled;
+}
+
+bool fmplayer_checkpoint_seek(struct fmplayer_checkpoint_index *ci,
+                              uint32_t timerb_cnt) {
+  if (!ci->cnt) return false;
+  size_t lo = 0, hi = ci->cnt;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (ci->checkpoints[mid]->timerb_cnt <= timerb_cnt) lo = mid;
+    else hi = mid;
+  }
+  checkpoint_restore(ci, ci->checkpoints[lo]);
+  // fast-forward: the driver runs at full speed and only the chip state
+  // is advanced, the timer might be stopped, do not run forever
+  uint64_t frames_left = (uint64_t)(timerb_cnt - ci->work->timerb_cnt + 1)
+                         * TIMERB_MAX_FRAMES;
+  bool status_disabled = ci->work->status_disabled;
+  ci->work->status_disabled = true;
+  while (ci->work->timerb_cnt < timerb_cnt && ci->work->playing
+         && frames_left) {
+    opna_timer_skip(ci->timer, SEEK_FRAMES);
+    fmplayer_checkpoint_update(ci);
+    frames_left -= (frames_left < SEEK_FRAMES) ? frames_left : SEEK_FRAMES;
+  }
+  ci->work->status_disabled = status_disabled;
+  return true;
+}
+
+uint32_t fmplayer_checkpoint_sec_ticks(const struct fmplayer_checkpoint_index *ci,
+                                       unsigned sec) {
+  // one timerb tick: (256 - timerb) * 16 frames
+  unsigned tickframes = (256 - ci->work->timerb) * 16;
+  return (uint64_t)sec * SRATE / tickframes;
+}
@@ -0,0 +1,73 @@
+#ifndef MYON_FMPLAYER_CHECKPOINT_H_INCLUDED
+#define MYON_FMPLAYER_CHECKPOINT_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+struct fmdriver_work;
+struct opna_timer;
+struct ppz8;
+struct fmplayer_file;
+struct fmplayer_checkpoint;
+
+enum {
+  // record a checkpoint every this many timerb ticks
+  FMPLAYER_CHECKPOINT_INTERVAL = 256,
+  // a checkpoint copies the driver and the song data,
+  // songs that never loop stop being indexed here
+  FMPLAYER_CHECKPOINT_MAX = 512,
+};
+
+// snapshots of the whole player state taken while playing,
+// used to seek without rendering from the beginning of the song
+// adpcm ram, ppz8 pcm buffers and drum rom are only written on load
+// and are not part of the checkpoints
+struct fmplayer_checkpoint_index {
+  struct fmdriver_work *work;
+  struct opna_timer *timer;
+  struct ppz8 *ppz8;
+  // driver struct and its (self-modifying) song data
+  void *driver;
+  size_t driversize;
+  uint8_t *data;
+  size_t datalen;
+  struct fmplayer_checkpoint **checkpoints;
+  size_t cnt;
+  size_t cap;
+};
+
+// call after the driver was initialized, records the first checkpoint
+// driver: work->driver, driversize bytes
+bool fmplayer_checkpoint_init(struct fmplayer_checkpoint_index *ci,
+                              struct fmdriver_work *work,
+                              struct opna_timer *timer,
+                              struct ppz8 *ppz8,
+                              size_t driversize,
+                              void *data, size_t datalen);
+// call after fmplayer_file_load
+bool fmplayer_checkpoint_init_file(struct fmplayer_checkpoint_index *ci,
+                                   struct fmdriver_work *work,
+                                   struct opna_timer *timer,
+                                   struct ppz8 *ppz8,
+                                   struct fmplayer_file *fmfile);
+void fmplayer_checkpoint_deinit(struct fmplayer_checkpoint_index *ci);
+// call after each opna_timer_mix, from the same thread
+// records checkpoints until the song loops or ends for the first time
+// (work->loop_cnt), at most FMPLAYER_CHECKPOINT_MAX
+void fmplayer_checkpoint_update(struct fmplayer_checkpoint_index *ci);
+// records the checkpoints of the first playthrough in advance,
+// fast-forwarding like fmplayer_checkpoint_seek, then rewinds to the start
+// for players that cannot record on their audio callback
+// call before the audio starts
+void fmplayer_checkpoint_build(struct fmplayer_checkpoint_index *ci);
+// restores the nearest checkpoint before timerb_cnt
+// then fast-forwards (at most FMPLAYER_CHECKPOINT_INTERVAL ticks if recorded)
+// call with the audio thread locked
+bool fmplayer_checkpoint_seek(struct fmplayer_checkpoint_index *ci,
+                              uint32_t timerb_cnt);
+// timerb ticks in sec seconds at the current tempo
+uint32_t fmplayer_checkpoint_sec_ticks(const struct fmplayer_checkpoint_index *ci,
+                                       unsigned sec);
+
+#endif // MYON_FMPLAYER_CHECKPOINT_H_INCLUDED
@@ -3,11 +3,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include "libopna/opnadrum.h"
+#include <stdatomic.h>
 
+// shared by all players, drum_rom is read-only once loaded is set
 static struct {
-  uint8_t drum_rom[OPNA_ROM_SIZE];
-  bool loaded;
-} g;
+  struct opna_drum_rom drum_rom;
+  atomic_bool loaded;
+  atomic_flag lock;
+} g = {
+  .lock = ATOMIC_FLAG_INIT,
+};
 
 #define DATADIR "/.local/share/98fmplayer/"
 
@@ -32,9 +37,11 @@ static void loadfile(void) {
   long size = ftell(rhythm);
   if (size != OPNA_ROM_SIZE) goto err_file;
   if (fseek(rhythm, 0, SEEK_SET) != 0) goto err_file;
-  if (fread(g.drum_rom, 1, OPNA_ROM_SIZE, rhythm) != OPNA_ROM_SIZE) goto err_file;
+  uint8_t data[OPNA_ROM_SIZE];
+  if (fread(data, 1, OPNA_ROM_SIZE, rhythm) != OPNA_ROM_SIZE) goto err_file;
   fclose(rhythm);
-  g.loaded = true;
+  opna_drum_rom_decode(&g.drum_rom, data);
+  atomic_store_explicit(&g.loaded, true, memory_order_release);
   return;
 err_file:
   fclose(rhythm);
@@ -43,11 +50,15 @@ err:
 }
 
 bool fmplayer_drum_rom_load(struct opna_drum *drum) {
-  if (!g.loaded) {
-    loadfile();
+  bool loaded = atomic_load_explicit(&g.loaded, memory_order_acquire);
+  if (!loaded) {
+    while (atomic_flag_test_and_set_explicit(&g.lock, memory_order_acquire));
+    if (!atomic_load_explicit(&g.loaded, memory_order_relaxed)) loadfile();
+    atomic_flag_clear_explicit(&g.lock, memory_order_release);
+    loaded = atomic_load_explicit(&g.loaded, memory_order_acquire);
   }
-  if (g.loaded) {
-    opna_drum_set_rom(drum, g.drum_rom);
+  if (loaded) {
+    opna_drum_set_rom(drum, &g.drum_rom);
   }
-  return g.loaded;
+  return loaded;
 }
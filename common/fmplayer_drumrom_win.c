@@ -4,10 +4,20 @@
 #include <windows.h>
 #include <shlwapi.h>
 #include <wchar.h>
+#if defined(_MSC_VER) && !defined(__cplusplus)
+#include "stdatomic.h"
+#else
+#include <stdatomic.h>
+#endif
+
+// shared by all players, drum_rom is read-only once loaded is set
 static struct {
-  char drum_rom[OPNA_ROM_SIZE];
-  bool loaded;
-} g;
+  struct opna_drum_rom drum_rom;
+  atomic_bool loaded;
+  atomic_flag lock;
+} g = {
+  .lock = ATOMIC_FLAG_INIT,
+};
 
 static void loadrom(void) {
   const wchar_t *path = L"ym2608_adpcm_rom.bin";
@@ -25,9 +35,11 @@ static void loadrom(void) {
   DWORD filesize = GetFileSize(file, 0);
   if (filesize != OPNA_ROM_SIZE) goto err;
   DWORD readbytes;
-  if (!ReadFile(file, g.drum_rom, OPNA_ROM_SIZE, &readbytes, 0) || readbytes != OPNA_ROM_SIZE) goto err;
+  uint8_t data[OPNA_ROM_SIZE];
+  if (!ReadFile(file, data, OPNA_ROM_SIZE, &readbytes, 0) || readbytes != OPNA_ROM_SIZE) goto err;
   CloseHandle(file);
-  g.loaded = true;
+  opna_drum_rom_decode(&g.drum_rom, data);
+  atomic_store_explicit(&g.loaded, true, memory_order_release);
   return;
 err:
   if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
@@ -36,13 +48,19 @@ err:
 
 
 bool fmplayer_drum_rom_load(struct opna_drum *drum) {
-  if (!g.loaded) loadrom();
-  if (g.loaded) {
-    opna_drum_set_rom(drum, g.drum_rom);
+  bool loaded = atomic_load_explicit(&g.loaded, memory_order_acquire);
+  if (!loaded) {
+    while (atomic_flag_test_and_set_explicit(&g.lock, memory_order_acquire));
+    if (!atomic_load_explicit(&g.loaded, memory_order_relaxed)) loadrom();
+    atomic_flag_clear_explicit(&g.lock, memory_order_release);
+    loaded = atomic_load_explicit(&g.loaded, memory_order_acquire);
+  }
+  if (loaded) {
+    opna_drum_set_rom(drum, &g.drum_rom);
   }
-  return g.loaded;
+  return loaded;
 }
 
 bool fmplayer_drum_loaded(void) {
-  return g.loaded;
+  return atomic_load_explicit(&g.loaded, memory_order_acquire);
 }
@@ -48,6 +48,7 @@ static void dummy_work_init(struct fmdriver_work *work, struct dummy_opna *dopna
   work->opna_readreg = opna_readreg_dummy;
   work->opna_status = opna_status_dummy;
   work->opna = dopna;
+  work->status_disabled = true;
 }
 
 static struct driver_pmd *pmd_dup(const struct driver_pmd *pmd) {
@@ -0,0 +1,63 @@
+#include "common/fmplayer_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool fmplayer_ring_init(struct fmplayer_ring *ring,
+                        unsigned frames, unsigned lookahead) {
+  ring->buf = malloc(sizeof(ring->buf[0]) * frames * 2);
+  if (!ring->buf) return false;
+  ring->frames = frames;
+  ring->lookahead = lookahead < frames ? lookahead : frames;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  return true;
+}
+
+void fmplayer_ring_deinit(struct fmplayer_ring *ring) {
+  free(ring->buf);
+  ring->buf = 0;
+}
+
+unsigned fmplayer_ring_filled(const struct fmplayer_ring *ring) {
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  return head - tail;
+}
+
+int16_t *fmplayer_ring_write_begin(struct fmplayer_ring *ring,
+                                   unsigned *frames) {
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  unsigned filled = head - tail;
+  unsigned space = filled < ring->lookahead ? ring->lookahead - filled : 0;
+  unsigned pos = head & (ring->frames - 1);
+  // do not wrap inside a block
+  if (space > ring->frames - pos) space = ring->frames - pos;
+  if (space > *frames) space = *frames;
+  *frames = space;
+  return ring->buf + pos*2;
+}
+
+void fmplayer_ring_write_commit(struct fmplayer_ring *ring, unsigned frames) {
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  atomic_store_explicit(&ring->head, head + frames, memory_order_release);
+}
+
+unsigned fmplayer_ring_read(struct fmplayer_ring *ring,
+                            int16_t *buf, unsigned frames) {
+  unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  if (frames > head - tail) frames = head - tail;
+  unsigned pos = tail & (ring->frames - 1);
+  unsigned first = ring->frames - pos;
+  if (first > frames) first = frames;
+  memcpy(buf, ring->buf + pos*2, sizeof(buf[0]) * first * 2);
+  memcpy(buf + first*2, ring->buf, sizeof(buf[0]) * (frames - first) * 2);
+  atomic_store_explicit(&ring->tail, tail + frames, memory_order_release);
+  return frames;
+}
+
+void fmplayer_ring_flush(struct fmplayer_ring *ring) {
+  atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+  atomic_store_explicit(&ring->tail, 0, memory_order_release);
+}
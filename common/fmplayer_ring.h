@@ -0,0 +1,42 @@
+#ifndef MYON_FMPLAYER_RING_H_INCLUDED
+#define MYON_FMPLAYER_RING_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+#if defined(_MSC_VER) && !defined(__cplusplus)
+#include "stdatomic.h"
+#else
+#include <stdatomic.h>
+#endif
+
+// lock-free ring of stereo frames between a synthesis thread (producer)
+// and the audio device callback (consumer)
+// the producer renders directly into the ring in blocks
+struct fmplayer_ring {
+  int16_t *buf;
+  // power of 2
+  unsigned frames;
+  // frames the producer keeps rendered ahead, at most frames
+  unsigned lookahead;
+  // total frames written and read, wrap around
+  atomic_uint head;
+  atomic_uint tail;
+};
+
+bool fmplayer_ring_init(struct fmplayer_ring *ring,
+                        unsigned frames, unsigned lookahead);
+void fmplayer_ring_deinit(struct fmplayer_ring *ring);
+// frames rendered and not read yet, can be called from both
+unsigned fmplayer_ring_filled(const struct fmplayer_ring *ring);
+// producer: returns a contiguous writable area of *frames frames,
+// *frames is 0 when lookahead frames are already rendered
+int16_t *fmplayer_ring_write_begin(struct fmplayer_ring *ring,
+                                   unsigned *frames);
+void fmplayer_ring_write_commit(struct fmplayer_ring *ring, unsigned frames);
+// consumer: copies up to frames frames, returns the number copied
+unsigned fmplayer_ring_read(struct fmplayer_ring *ring,
+                            int16_t *buf, unsigned frames);
+// drops rendered frames, neither side may run
+void fmplayer_ring_flush(struct fmplayer_ring *ring);
+
+#endif // MYON_FMPLAYER_RING_H_INCLUDED
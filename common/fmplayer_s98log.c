@@ -0,0 +1,187 @@
+#include "common/fmplayer_s98log.h"
+#include "fmdriver/fmdriver.h"
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  OPNA_CLOCK = 7987200,
+  HEADER_LEN = 0x20,
+  DEVICE_LEN = 0x10,
+  DEVICE_OPNA = 4,
+};
+
+static void write32le(uint8_t *ptr, uint32_t data) {
+  ptr[0] = data;
+  ptr[1] = data >> 8;
+  ptr[2] = data >> 16;
+  ptr[3] = data >> 24;
+}
+
+static void s98log_push(struct fmplayer_s98log *log, uint8_t data) {
+  if (log->err) return;
+  if (log->len == log->cap) {
+    size_t newcap = log->cap * 2;
+    uint8_t *newdata = realloc(log->data, newcap);
+    if (!newdata) {
+      log->err = true;
+      return;
+    }
+    log->data = newdata;
+    log->cap = newcap;
+  }
+  log->data[log->len++] = data;
+}
+
+static void s98log_sync(struct fmplayer_s98log *log) {
+  uint64_t ticks = log->frame - log->data_frame;
+  log->data_frame = log->frame;
+  if (!ticks) return;
+  if (ticks == 1) {
+    s98log_push(log, 0xff);
+    return;
+  }
+  s98log_push(log, 0xfe);
+  ticks -= 2;
+  do {
+    s98log_push(log, (ticks & 0x7f) | ((ticks >> 7) ? 0x80 : 0));
+    ticks >>= 7;
+  } while (ticks);
+}
+
+static void s98log_record(struct fmplayer_s98log *log,
+                          unsigned addr, unsigned data) {
+  if (log->done) return;
+  data &= 0xff;
+  switch (addr) {
+  case 0x24:
+  case 0x25:
+  case 0x26:
+    return;
+  case 0x27:
+    data &= 0xc0;
+    if (data == log->ch3mode) return;
+    log->ch3mode = data;
+    break;
+  }
+  s98log_sync(log);
+  s98log_push(log, (addr >> 8) & 1);
+  s98log_push(log, addr & 0xff);
+  s98log_push(log, data);
+}
+
+static void s98log_check_loop(struct fmplayer_s98log *log) {
+  if (log->done) return;
+  uint8_t loop_cnt = log->work->loop_cnt;
+  if (loop_cnt == 0xff) {
+    // ended without looping
+    s98log_sync(log);
+    log->loop_offset = 0;
+    log->done = true;
+  } else if (loop_cnt >= 2) {
+    s98log_sync(log);
+    log->done = true;
+  } else if (loop_cnt == 1 && !log->loop_offset) {
+    s98log_sync(log);
+    log->loop_offset = log->len;
+  }
+}
+
+static void s98log_opna_writereg(struct fmdriver_work *work,
+                                 unsigned addr, unsigned data) {
+  struct fmplayer_s98log *log = (struct fmplayer_s98log *)work->opna;
+  s98log_record(log, addr, data);
+  work->opna = log->opna;
+  log->opna_writereg(work, addr, data);
+  work->opna = log;
+}
+
+static unsigned s98log_opna_readreg(struct fmdriver_work *work,
+                                    unsigned addr) {
+  struct fmplayer_s98log *log = (struct fmplayer_s98log *)work->opna;
+  work->opna = log->opna;
+  unsigned ret = log->opna_readreg(work, addr);
+  work->opna = log;
+  return ret;
+}
+
+static uint8_t s98log_opna_status(struct fmdriver_work *work, bool a1) {
+  struct fmplayer_s98log *log = (struct fmplayer_s98log *)work->opna;
+  work->opna = log->opna;
+  uint8_t ret = log->opna_status(work, a1);
+  work->opna = log;
+  return ret;
+}
+
+static void s98log_mix_cb(void *userptr, int16_t *buf, unsigned samples) {
+  struct fmplayer_s98log *log = (struct fmplayer_s98log *)userptr;
+  s98log_check_loop(log);
+  log->frame += samples;
+  if (log->mix_cb) log->mix_cb(log->mix_userptr, buf, samples);
+}
+
+static void s98log_skip_cb(void *userptr, unsigned samples) {
+  struct fmplayer_s98log *log = (struct fmplayer_s98log *)userptr;
+  s98log_check_loop(log);
+  log->frame += samples;
+  if (log->skip_cb) log->skip_cb(log->mix_userptr, samples);
+}
+
+bool fmplayer_s98log_init(struct fmplayer_s98log *log,
+                          struct fmdriver_work *work,
+                          struct opna_timer *timer) {
+  log->cap = 1<<16;
+  log->data = malloc(log->cap);
+  if (!log->data) return false;
+  log->len = HEADER_LEN + DEVICE_LEN;
+  memset(log->data, 0, log->len);
+  log->work = work;
+  log->timer = timer;
+  log->opna_writereg = work->opna_writereg;
+  log->opna_readreg = work->opna_readreg;
+  log->opna_status = work->opna_status;
+  log->opna = work->opna;
+  log->mix_cb = timer->mix_cb;
+  log->skip_cb = timer->skip_cb;
+  log->mix_userptr = timer->mix_userptr;
+  log->frame = 0;
+  log->data_frame = 0;
+  log->ch3mode = 0;
+  log->loop_offset = 0;
+  log->done = false;
+  log->err = false;
+  work->opna_writereg = s98log_opna_writereg;
+  if (log->opna_readreg) work->opna_readreg = s98log_opna_readreg;
+  if (log->opna_status) work->opna_status = s98log_opna_status;
+  work->opna = log;
+  opna_timer_set_mix_callback(timer, s98log_mix_cb, log);
+  opna_timer_set_skip_callback(timer, s98log_skip_cb);
+  return true;
+}
+
+void *fmplayer_s98log_finish(struct fmplayer_s98log *log, size_t *size) {
+  struct fmdriver_work *work = log->work;
+  work->opna_writereg = log->opna_writereg;
+  work->opna_readreg = log->opna_readreg;
+  work->opna_status = log->opna_status;
+  work->opna = log->opna;
+  opna_timer_set_mix_callback(log->timer, log->mix_cb, log->mix_userptr);
+  opna_timer_set_skip_callback(log->timer, log->skip_cb);
+  if (!log->done) s98log_sync(log);
+  s98log_push(log, 0xfd);
+  if (log->err) {
+    free(log->data);
+    return 0;
+  }
+  uint8_t *data = log->data;
+  memcpy(data, "S983", 4);
+  // one tick: 144 / OPNA_CLOCK seconds = one frame
+  write32le(data+0x04, 144);
+  write32le(data+0x08, OPNA_CLOCK);
+  write32le(data+0x14, HEADER_LEN + DEVICE_LEN);
+  write32le(data+0x18, log->loop_offset);
+  write32le(data+0x1c, 1);
+  write32le(data+0x20, DEVICE_OPNA);
+  write32le(data+0x24, OPNA_CLOCK);
+  *size = log->len;
+  return data;
+}
@@ -0,0 +1,49 @@
+#ifndef MYON_FMPLAYER_S98LOG_H_INCLUDED
+#define MYON_FMPLAYER_S98LOG_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "libopna/opnatimer.h"
+
+struct fmdriver_work;
+
+// records the register writes of the driver with the frame they were
+// written at, and serializes them as S98 v3 (one OPNA, one tick per frame)
+// the loop point is set when the song loops the first time,
+// recording is done when it loops the second time or ends
+// ppz8 is not recorded
+struct fmplayer_s98log {
+  struct fmdriver_work *work;
+  struct opna_timer *timer;
+  // wrapped callbacks
+  void (*opna_writereg)(struct fmdriver_work *work, unsigned addr, unsigned data);
+  unsigned (*opna_readreg)(struct fmdriver_work *work, unsigned addr);
+  uint8_t (*opna_status)(struct fmdriver_work *work, bool a1);
+  void *opna;
+  opna_timer_mix_cb_t mix_cb;
+  opna_timer_skip_cb_t skip_cb;
+  void *mix_userptr;
+  uint64_t frame;
+  // frame at the end of data
+  uint64_t data_frame;
+  // last recorded ch3 mode of 0x27, the timer bits are not recorded
+  uint8_t ch3mode;
+  uint8_t *data;
+  size_t len;
+  size_t cap;
+  size_t loop_offset;
+  bool done;
+  bool err;
+};
+
+// call after the opna callbacks of work and timer are set,
+// before the driver init so the initialization and adpcm writes are recorded
+bool fmplayer_s98log_init(struct fmplayer_s98log *log,
+                          struct fmdriver_work *work,
+                          struct opna_timer *timer);
+// removes the recorder from work and timer
+// returns the S98 data (free with free()), 0 when out of memory
+void *fmplayer_s98log_finish(struct fmplayer_s98log *log, size_t *size);
+
+#endif // MYON_FMPLAYER_S98LOG_H_INCLUDED
@@ -0,0 +1,275 @@
+#include "common/fmplayer_seq.h"
+#include "fmdriver/fmdriver.h"
+#include "libopna/opna.h"
+#include <stddef.h>
+
+enum {
+  // queue space is checked between steps
+  RUN_FRAMES = 16,
+};
+
+static struct fmplayer_seq *seq_from_ppz8(struct ppz8 *ppz8) {
+  return (struct fmplayer_seq *)
+    ((char *)ppz8 - offsetof(struct fmplayer_seq, ppz8_voices));
+}
+
+static void seq_push(struct fmplayer_seq *seq,
+                     enum fmplayer_seq_event_type type,
+                     unsigned ch, unsigned reg,
+                     uint32_t val, uint32_t val2) {
+  unsigned head = atomic_load_explicit(&seq->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&seq->tail, memory_order_acquire);
+  // full: only when a single step wrote more than the margin
+  if (head - tail >= FMPLAYER_SEQ_QUEUE_LEN) {
+    atomic_store_explicit(&seq->overflow, true, memory_order_release);
+    return;
+  }
+  struct fmplayer_seq_event *e =
+    &seq->queue[head & (FMPLAYER_SEQ_QUEUE_LEN-1)];
+  e->frame = seq->frame;
+  e->type = type;
+  e->ch = ch;
+  e->reg = reg;
+  e->val = val;
+  e->val2 = val2;
+  atomic_store_explicit(&seq->head, head+1, memory_order_release);
+}
+
+static void seq_opna_writereg(struct fmdriver_work *work,
+                              unsigned addr, unsigned data) {
+  struct fmplayer_seq *seq = (struct fmplayer_seq *)work->opna;
+  opna_timer_writereg(&seq->timer, addr, data);
+  if (addr < 0x10) seq->ssgregs[addr] = data;
+  seq_push(seq, FMPLAYER_SEQ_OPNA_WRITEREG, 0, addr, data & 0xff, 0);
+}
+
+static unsigned seq_opna_readreg(struct fmdriver_work *work, unsigned addr) {
+  struct fmplayer_seq *seq = (struct fmplayer_seq *)work->opna;
+  if (addr > 0xfu) return 0xff;
+  return seq->ssgregs[addr];
+}
+
+static uint8_t seq_opna_status(struct fmdriver_work *work, bool a1) {
+  struct fmplayer_seq *seq = (struct fmplayer_seq *)work->opna;
+  uint8_t status = opna_timer_status(&seq->timer);
+  if (!a1) {
+    status &= 0x83;
+  }
+  return status;
+}
+
+static void seq_timer_int_cb(void *userptr) {
+  struct fmplayer_seq *seq = (struct fmplayer_seq *)userptr;
+  seq->work->driver_opna_interrupt(seq->work);
+  if (seq->work->loop_cnt != seq->seq_loop_cnt) {
+    seq->seq_loop_cnt = seq->work->loop_cnt;
+    seq_push(seq, FMPLAYER_SEQ_LOOP, 0, 0, seq->seq_loop_cnt, 0);
+  }
+  if (seq->work->timerb_cnt != seq->seq_timerb_cnt) {
+    seq->seq_timerb_cnt = seq->work->timerb_cnt;
+    seq_push(seq, FMPLAYER_SEQ_TIMERB, 0, 0, seq->seq_timerb_cnt, 0);
+  }
+}
+
+static void seq_timer_skip_cb(void *userptr, unsigned samples) {
+  struct fmplayer_seq *seq = (struct fmplayer_seq *)userptr;
+  seq->frame += samples;
+}
+
+static void seq_ppz8_play(struct ppz8 *ppz8, uint8_t ch, uint8_t voice) {
+  seq_push(seq_from_ppz8(ppz8), FMPLAYER_SEQ_PPZ8_PLAY, ch, 0, voice, 0);
+}
+
+static void seq_ppz8_stop(struct ppz8 *ppz8, uint8_t ch) {
+  seq_push(seq_from_ppz8(ppz8), FMPLAYER_SEQ_PPZ8_STOP, ch, 0, 0, 0);
+}
+
+static void seq_ppz8_volume(struct ppz8 *ppz8, uint8_t ch, uint8_t vol) {
+  seq_push(seq_from_ppz8(ppz8), FMPLAYER_SEQ_PPZ8_VOLUME, ch, 0, vol, 0);
+}
+
+static void seq_ppz8_freq(struct ppz8 *ppz8, uint8_t ch, uint32_t freq) {
+  seq_push(seq_from_ppz8(ppz8), FMPLAYER_SEQ_PPZ8_FREQ, ch, 0, freq, 0);
+}
+
+static void seq_ppz8_loopoffset(struct ppz8 *ppz8, uint8_t ch,
+                                uint32_t startoff, uint32_t endoff) {
+  seq_push(seq_from_ppz8(ppz8), FMPLAYER_SEQ_PPZ8_LOOPOFFSET,
+           ch, 0, startoff, endoff);
+}
+
+static void seq_ppz8_pan(struct ppz8 *ppz8, uint8_t ch, uint8_t pan) {
+  seq_push(seq_from_ppz8(ppz8), FMPLAYER_SEQ_PPZ8_PAN, ch, 0, pan, 0);
+}
+
+static void seq_ppz8_total_volume(struct ppz8 *ppz8, uint8_t vol) {
+  seq_push(seq_from_ppz8(ppz8), FMPLAYER_SEQ_PPZ8_TOTAL_VOLUME, 0, 0, vol, 0);
+}
+
+static void seq_ppz8_loop_voice(struct ppz8 *ppz8, uint8_t ch, uint8_t voice) {
+  seq_push(seq_from_ppz8(ppz8), FMPLAYER_SEQ_PPZ8_LOOP_VOICE, ch, 0, voice, 0);
+}
+
+static uint32_t seq_ppz8_voice_length(struct ppz8 *ppz8, uint8_t voice) {
+  // pcm voice tables are only written on load
+  return ppz8_functbl.voice_length(ppz8, voice);
+}
+
+static const struct ppz8_functbl seq_ppz8_functbl = {
+  seq_ppz8_play,
+  seq_ppz8_stop,
+  seq_ppz8_volume,
+  seq_ppz8_freq,
+  seq_ppz8_loopoffset,
+  seq_ppz8_pan,
+  seq_ppz8_total_volume,
+  seq_ppz8_loop_voice,
+  seq_ppz8_voice_length
+};
+
+void fmplayer_seq_init(struct fmplayer_seq *seq,
+                       struct fmdriver_work *work,
+                       struct opna_timer *timer,
+                       struct ppz8 *ppz8) {
+  seq->work = work;
+  seq->opna = timer->opna;
+  seq->ppz8 = ppz8;
+  // continue from the timer state the driver init left
+  seq->timer = *timer;
+  seq->timer.opna = 0;
+  opna_timer_set_int_callback(&seq->timer, seq_timer_int_cb, seq);
+  opna_timer_set_mix_callback(&seq->timer, 0, seq);
+  opna_timer_set_skip_callback(&seq->timer, seq_timer_skip_cb);
+  for (unsigned r = 0; r < 0x10; r++) {
+    seq->ssgregs[r] = opna_readreg(seq->opna, r);
+  }
+  seq->ppz8_voices = *ppz8;
+  seq->frame = 0;
+  seq->seq_loop_cnt = work->loop_cnt;
+  seq->loop_cnt = work->loop_cnt;
+  seq->seq_timerb_cnt = work->timerb_cnt;
+  seq->timerb_cnt = work->timerb_cnt;
+  atomic_init(&seq->head, 0);
+  atomic_init(&seq->seq_frame, 0);
+  atomic_init(&seq->overflow, false);
+  atomic_init(&seq->tail, 0);
+  atomic_init(&seq->synth_frame, 0);
+  work->opna_writereg = seq_opna_writereg;
+  work->opna_readreg = seq_opna_readreg;
+  work->opna_status = seq_opna_status;
+  work->opna = seq;
+  work->ppz8 = &seq->ppz8_voices;
+  work->ppz8_functbl = &seq_ppz8_functbl;
+}
+
+unsigned fmplayer_seq_run(struct fmplayer_seq *seq, unsigned frames) {
+  unsigned done = 0;
+  while (done < frames) {
+    unsigned head = atomic_load_explicit(&seq->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&seq->tail, memory_order_acquire);
+    if (FMPLAYER_SEQ_QUEUE_LEN - (head - tail) < FMPLAYER_SEQ_QUEUE_MARGIN) {
+      break;
+    }
+    unsigned step = frames - done;
+    if (step > RUN_FRAMES) step = RUN_FRAMES;
+    opna_timer_skip(&seq->timer, step);
+    done += step;
+  }
+  atomic_store_explicit(&seq->seq_frame, seq->frame, memory_order_release);
+  return done;
+}
+
+unsigned fmplayer_seq_ahead(const struct fmplayer_seq *seq) {
+  uint32_t seq_frame =
+    atomic_load_explicit(&seq->seq_frame, memory_order_acquire);
+  uint32_t synth_frame =
+    atomic_load_explicit(&seq->synth_frame, memory_order_acquire);
+  int32_t ahead = seq_frame - synth_frame;
+  return ahead > 0 ? ahead : 0;
+}
+
+bool fmplayer_seq_overflowed(const struct fmplayer_seq *seq) {
+  return atomic_load_explicit(&seq->overflow, memory_order_acquire);
+}
+
+static void seq_apply(struct fmplayer_seq *seq,
+                      const struct fmplayer_seq_event *e) {
+  switch (e->type) {
+  case FMPLAYER_SEQ_OPNA_WRITEREG:
+    opna_writereg(seq->opna, e->reg, e->val);
+    break;
+  case FMPLAYER_SEQ_PPZ8_PLAY:
+    ppz8_functbl.channel_play(seq->ppz8, e->ch, e->val);
+    break;
+  case FMPLAYER_SEQ_PPZ8_STOP:
+    ppz8_functbl.channel_stop(seq->ppz8, e->ch);
+    break;
+  case FMPLAYER_SEQ_PPZ8_VOLUME:
+    ppz8_functbl.channel_volume(seq->ppz8, e->ch, e->val);
+    break;
+  case FMPLAYER_SEQ_PPZ8_FREQ:
+    ppz8_functbl.channel_freq(seq->ppz8, e->ch, e->val);
+    break;
+  case FMPLAYER_SEQ_PPZ8_LOOPOFFSET:
+    ppz8_functbl.channel_loopoffset(seq->ppz8, e->ch, e->val, e->val2);
+    break;
+  case FMPLAYER_SEQ_PPZ8_PAN:
+    ppz8_functbl.channel_pan(seq->ppz8, e->ch, e->val);
+    break;
+  case FMPLAYER_SEQ_PPZ8_TOTAL_VOLUME:
+    ppz8_functbl.total_volume(seq->ppz8, e->val);
+    break;
+  case FMPLAYER_SEQ_PPZ8_LOOP_VOICE:
+    ppz8_functbl.channel_loop_voice(seq->ppz8, e->ch, e->val);
+    break;
+  case FMPLAYER_SEQ_LOOP:
+    seq->loop_cnt = e->val;
+    break;
+  case FMPLAYER_SEQ_TIMERB:
+    seq->timerb_cnt = e->val;
+    break;
+  }
+}
+
+// buf == 0: skip
+static void seq_synth(struct fmplayer_seq *seq,
+                      int16_t *buf, unsigned frames) {
+  uint32_t synth_frame =
+    atomic_load_explicit(&seq->synth_frame, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&seq->tail, memory_order_relaxed);
+  while (frames) {
+    unsigned head = atomic_load_explicit(&seq->head, memory_order_acquire);
+    unsigned n = frames;
+    while (tail != head) {
+      const struct fmplayer_seq_event *e =
+        &seq->queue[tail & (FMPLAYER_SEQ_QUEUE_LEN-1)];
+      int32_t d = e->frame - synth_frame;
+      if (d > 0) {
+        if ((unsigned)d < n) n = d;
+        break;
+      }
+      seq_apply(seq, e);
+      tail++;
+    }
+    atomic_store_explicit(&seq->tail, tail, memory_order_release);
+    if (buf) {
+      opna_mix(seq->opna, buf, n);
+      ppz8_mix(seq->ppz8, buf, n);
+      buf += n*2;
+    } else {
+      opna_skip(seq->opna, n);
+      ppz8_skip(seq->ppz8, n);
+    }
+    synth_frame += n;
+    frames -= n;
+    atomic_store_explicit(&seq->synth_frame, synth_frame, memory_order_release);
+  }
+}
+
+void fmplayer_seq_mix(struct fmplayer_seq *seq, int16_t *buf, unsigned frames) {
+  seq_synth(seq, buf, frames);
+}
+
+void fmplayer_seq_skip(struct fmplayer_seq *seq, unsigned frames) {
+  seq_synth(seq, 0, frames);
+}
@@ -0,0 +1,107 @@
+#ifndef MYON_FMPLAYER_SEQ_H_INCLUDED
+#define MYON_FMPLAYER_SEQ_H_INCLUDED
+
+#include <stdint.h>
+#include <stdbool.h>
+#if defined(_MSC_VER) && !defined(__cplusplus)
+#include "stdatomic.h"
+#else
+#include <stdatomic.h>
+#endif
+#include "libopna/opnatimer.h"
+#include "fmdriver/ppz8.h"
+
+struct fmdriver_work;
+struct opna;
+
+enum {
+  // must be a power of 2
+  FMPLAYER_SEQ_QUEUE_LEN = 1<<14,
+  // fmplayer_seq_run stops when less than this many entries are free
+  // more than one interrupt never writes this much
+  FMPLAYER_SEQ_QUEUE_MARGIN = 1<<11,
+};
+
+enum fmplayer_seq_event_type {
+  FMPLAYER_SEQ_OPNA_WRITEREG,
+  FMPLAYER_SEQ_PPZ8_PLAY,
+  FMPLAYER_SEQ_PPZ8_STOP,
+  FMPLAYER_SEQ_PPZ8_VOLUME,
+  FMPLAYER_SEQ_PPZ8_FREQ,
+  FMPLAYER_SEQ_PPZ8_LOOPOFFSET,
+  FMPLAYER_SEQ_PPZ8_PAN,
+  FMPLAYER_SEQ_PPZ8_TOTAL_VOLUME,
+  FMPLAYER_SEQ_PPZ8_LOOP_VOICE,
+  // work->loop_cnt changed
+  FMPLAYER_SEQ_LOOP,
+  // work->timerb_cnt changed
+  FMPLAYER_SEQ_TIMERB,
+};
+
+struct fmplayer_seq_event {
+  // frame the event takes effect, wraps around
+  uint32_t frame;
+  uint8_t type;
+  // ppz8 channel
+  uint8_t ch;
+  // opna register
+  uint16_t reg;
+  uint32_t val;
+  uint32_t val2;
+};
+
+// runs the driver ahead of the chip:
+// the sequencer side runs the driver interrupts against a timer
+// without synthesis and queues chip register writes and ppz8 calls
+// with frame timestamps,
+// the synthesis side mixes in blocks only split where events take effect
+// fmplayer_seq_run and fmplayer_seq_mix/skip can be called from
+// different threads (single producer, single consumer)
+struct fmplayer_seq {
+  // sequencer side
+  struct fmdriver_work *work;
+  struct opna_timer timer;
+  uint8_t ssgregs[0x10];
+  // pcm voice table for voice_length, work->ppz8 points here
+  struct ppz8 ppz8_voices;
+  uint32_t frame;
+  uint8_t seq_loop_cnt;
+  uint32_t seq_timerb_cnt;
+  // synthesis side
+  struct opna *opna;
+  struct ppz8 *ppz8;
+  // work->loop_cnt and work->timerb_cnt at the synthesized position
+  uint8_t loop_cnt;
+  uint32_t timerb_cnt;
+  struct fmplayer_seq_event queue[FMPLAYER_SEQ_QUEUE_LEN];
+  // written by the sequencer
+  atomic_uint head;
+  atomic_uint seq_frame;
+  // an event was dropped because the queue was full
+  atomic_bool overflow;
+  // written by the synthesis
+  atomic_uint tail;
+  atomic_uint synth_frame;
+};
+
+// takes over work set up by fmplayer_init_work_opna,
+// call after fmplayer_file_load (or the driver init) and pcm loading
+// timer is not used after this
+void fmplayer_seq_init(struct fmplayer_seq *seq,
+                       struct fmdriver_work *work,
+                       struct opna_timer *timer,
+                       struct ppz8 *ppz8);
+// runs the driver for up to frames frames
+// returns the number of frames run, less than frames when the queue is full
+unsigned fmplayer_seq_run(struct fmplayer_seq *seq, unsigned frames);
+// frames the sequencer is ahead of the synthesis, can be called from both
+unsigned fmplayer_seq_ahead(const struct fmplayer_seq *seq);
+// true when a single driver step wrote more than the queue could hold
+// and an event was dropped, the synthesis is wrong from there on,
+// can be called from both
+bool fmplayer_seq_overflowed(const struct fmplayer_seq *seq);
+// events not run by the sequencer yet are applied late
+void fmplayer_seq_mix(struct fmplayer_seq *seq, int16_t *buf, unsigned frames);
+void fmplayer_seq_skip(struct fmplayer_seq *seq, unsigned frames);
+
+#endif // MYON_FMPLAYER_SEQ_H_INCLUDED
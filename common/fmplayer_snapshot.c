@@ -0,0 +1,93 @@
+#include "common/fmplayer_snapshot.h"
+#include "libopna/opna.h"
+#include "fmdriver/ppz8.h"
+#include <string.h>
+
+void fmplayer_snapshot_take(struct fmplayer_snapshot *snap,
+                            struct fmdriver_work *work,
+                            struct opna *opna) {
+  memcpy(snap->track_status, work->track_status, sizeof(snap->track_status));
+  snap->timerb_cnt = work->timerb_cnt;
+  snap->timerb_cnt_loop = work->timerb_cnt_loop;
+  snap->loop_timerb_cnt = work->loop_timerb_cnt;
+  snap->timerb = work->timerb;
+  snap->loop_cnt = work->loop_cnt;
+  snap->ssg_noise_freq = work->ssg_noise_freq;
+  snap->playing = work->playing;
+  snap->paused = work->paused;
+
+  snap->generated_frames = opna->generated_frames;
+  for (int c = 0; c < 6; c++) {
+    const struct opna_fm_channel *ch = &opna->fm.channel[c];
+    snap->fm[c].fnum = ch->fnum;
+    snap->fm[c].lselect = opna->fm.lselect[c];
+    snap->fm[c].rselect = opna->fm.rselect[c];
+    for (int s = 0; s < 4; s++) {
+      snap->fm[c].slot[s].env = ch->slot[s].env;
+      snap->fm[c].slot[s].env_state = ch->slot[s].env_state;
+      snap->fm[c].slot[s].tl = ch->slot[s].tl;
+    }
+    snap->level[FMPLAYER_SNAPSHOT_LEVEL_FM+c] =
+      leveldata_read(&opna->fm.channel[c].leveldata);
+  }
+  for (int i = 0; i < 3; i++) {
+    snap->fm3_fnum[i] = opna->fm.ch3.fnum[i];
+  }
+  for (int c = 0; c < 3; c++) {
+    snap->ssg[c].tone_period = opna_ssg_tone_period(&opna->ssg, c);
+    snap->ssg[c].level = opna_ssg_channel_level(&opna->ssg, c);
+    snap->level[FMPLAYER_SNAPSHOT_LEVEL_SSG+c] =
+      leveldata_read(&opna->resampler.leveldata[c]);
+  }
+  snap->adpcm.ramptr = opna->adpcm.ramptr;
+  snap->adpcm.delta = opna->adpcm.delta;
+  snap->adpcm.start = opna->adpcm.start;
+  snap->adpcm.end = opna->adpcm.end;
+  snap->adpcm.vol = opna->adpcm.vol;
+  snap->adpcm.control2 = opna->adpcm.control2;
+  snap->level[FMPLAYER_SNAPSHOT_LEVEL_ADPCM] =
+    leveldata_read(&opna->adpcm.leveldata);
+  for (int d = 0; d < 6; d++) {
+    snap->drum_playing[d] = opna->drum.drums[d].playing;
+    snap->level[FMPLAYER_SNAPSHOT_LEVEL_DRUM+d] =
+      leveldata_read(&opna->drum.drums[d].leveldata);
+  }
+
+  snap->ppz8_enabled = work->ppz8;
+  for (int p = 0; p < 8; p++) {
+    if (!work->ppz8) {
+      memset(&snap->ppz8[p], 0, sizeof(snap->ppz8[p]));
+      snap->level[FMPLAYER_SNAPSHOT_LEVEL_PPZ8+p] = 0;
+      continue;
+    }
+    const struct ppz8_channel *ch = &work->ppz8->channel[p];
+    snap->ppz8[p].ptr = ch->ptr;
+    snap->ppz8[p].loopstartptr = ch->loopstartptr;
+    snap->ppz8[p].loopendptr = ch->loopendptr;
+    snap->ppz8[p].endptr = ch->endptr;
+    snap->ppz8[p].freq = ch->freq;
+    snap->ppz8[p].vol = ch->vol;
+    snap->ppz8[p].pan = ch->pan;
+    snap->level[FMPLAYER_SNAPSHOT_LEVEL_PPZ8+p] =
+      leveldata_read(&work->ppz8->channel[p].leveldata);
+  }
+}
+
+void fmplayer_snapshots_init(struct fmplayer_snapshots *snaps) {
+  memset(snaps->snap, 0, sizeof(snaps->snap));
+  fmplayer_triple_init(&snaps->triple);
+}
+
+void fmplayer_snapshots_publish(struct fmplayer_snapshots *snaps,
+                                struct fmdriver_work *work,
+                                struct opna *opna) {
+  struct fmplayer_snapshot *snap = &snaps->snap[snaps->triple.back];
+  // back is the snapshot the reader skipped, keep its peaks
+  unsigned prev[FMPLAYER_SNAPSHOT_LEVEL_CNT] = {0};
+  if (snaps->triple.dropped) memcpy(prev, snap->level, sizeof(prev));
+  fmplayer_snapshot_take(snap, work, opna);
+  for (int i = 0; i < FMPLAYER_SNAPSHOT_LEVEL_CNT; i++) {
+    if (prev[i] > snap->level[i]) snap->level[i] = prev[i];
+  }
+  fmplayer_triple_publish(&snaps->triple);
+}
@@ -0,0 +1,108 @@
+#ifndef MYON_FMPLAYER_SNAPSHOT_H_INCLUDED
+#define MYON_FMPLAYER_SNAPSHOT_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fmdriver/fmdriver.h"
+#include "common/fmplayer_triple.h"
+
+struct opna;
+
+// index of fmplayer_snapshot.level
+enum {
+  FMPLAYER_SNAPSHOT_LEVEL_FM = 0,
+  FMPLAYER_SNAPSHOT_LEVEL_SSG = 6,
+  FMPLAYER_SNAPSHOT_LEVEL_DRUM = 9,
+  FMPLAYER_SNAPSHOT_LEVEL_ADPCM = 15,
+  FMPLAYER_SNAPSHOT_LEVEL_PPZ8 = 16,
+  FMPLAYER_SNAPSHOT_LEVEL_CNT = 24,
+};
+
+struct fmplayer_snapshot_fm_slot {
+  uint16_t env;
+  uint8_t env_state;
+  uint8_t tl;
+};
+
+struct fmplayer_snapshot_fm {
+  struct fmplayer_snapshot_fm_slot slot[4];
+  uint16_t fnum;
+  bool lselect;
+  bool rselect;
+};
+
+struct fmplayer_snapshot_ppz8 {
+  uint64_t ptr;
+  uint64_t loopstartptr;
+  uint64_t loopendptr;
+  uint64_t endptr;
+  uint32_t freq;
+  uint8_t vol;
+  uint8_t pan;
+};
+
+// what fmdsp shows of the driver and the chip at one point,
+// copied by the thread running them so the display never reads
+// state while it is being written
+struct fmplayer_snapshot {
+  // driver
+  struct fmdriver_track_status track_status[FMDRIVER_TRACK_NUM];
+  uint32_t timerb_cnt;
+  uint32_t timerb_cnt_loop;
+  uint32_t loop_timerb_cnt;
+  uint8_t timerb;
+  uint8_t loop_cnt;
+  uint8_t ssg_noise_freq;
+  bool playing;
+  bool paused;
+  // chip
+  uint64_t generated_frames;
+  struct fmplayer_snapshot_fm fm[6];
+  uint16_t fm3_fnum[3];
+  struct {
+    uint16_t tone_period;
+    // see opna_ssg_channel_level
+    uint8_t level;
+  } ssg[3];
+  struct {
+    uint32_t ramptr;
+    uint16_t delta;
+    uint16_t start;
+    uint16_t end;
+    uint8_t vol;
+    uint8_t control2;
+  } adpcm;
+  bool drum_playing[6];
+  // false when the driver has no ppz8
+  bool ppz8_enabled;
+  struct fmplayer_snapshot_ppz8 ppz8[8];
+  // peaks since the previous snapshot, see leveldata
+  unsigned level[FMPLAYER_SNAPSHOT_LEVEL_CNT];
+};
+
+// one writer publishes, one reader takes the latest, neither waits
+struct fmplayer_snapshots {
+  struct fmplayer_snapshot snap[3];
+  struct fmplayer_triple triple;
+};
+
+// copies the state the display needs, also reads the level peaks
+void fmplayer_snapshot_take(struct fmplayer_snapshot *snap,
+                            struct fmdriver_work *work,
+                            struct opna *opna);
+
+void fmplayer_snapshots_init(struct fmplayer_snapshots *snaps);
+// writer: the thread running the driver and the chip,
+// after each block it generated
+// level peaks of snapshots the reader skipped are carried over
+void fmplayer_snapshots_publish(struct fmplayer_snapshots *snaps,
+                                struct fmdriver_work *work,
+                                struct opna *opna);
+
+// reader: the latest published snapshot
+static inline const struct fmplayer_snapshot *fmplayer_snapshots_read(
+    struct fmplayer_snapshots *snaps) {
+  return &snaps->snap[fmplayer_triple_read(&snaps->triple, 0)];
+}
+
+#endif // MYON_FMPLAYER_SNAPSHOT_H_INCLUDED
@@ -0,0 +1,73 @@
+#include "common/fmplayer_spectrum.h"
+#include <string.h>
+
+enum {
+  // about 0.3 s at 55467 Hz
+  RING_FRAMES = 1<<14,
+  READ_FRAMES = 1024,
+};
+
+bool fmplayer_spectrum_init(struct fmplayer_spectrum *spec, unsigned hop) {
+  fft_init_table();
+  if (!fmplayer_ring_init(&spec->ring, RING_FRAMES, RING_FRAMES)) {
+    return false;
+  }
+  spec->hop = hop ? hop : 1;
+  spec->pending = 0;
+  atomic_init(&spec->tracks_want, true);
+  memset(&spec->idata.fdata, 0, sizeof(spec->idata.fdata));
+  memset(&spec->cur, 0, sizeof(spec->cur));
+  memset(spec->disp, 0, sizeof(spec->disp));
+  fmplayer_triple_init(&spec->triple);
+  return true;
+}
+
+void fmplayer_spectrum_deinit(struct fmplayer_spectrum *spec) {
+  fmplayer_ring_deinit(&spec->ring);
+}
+
+void fmplayer_spectrum_write(struct fmplayer_spectrum *spec,
+                             const int16_t *buf, unsigned frames) {
+  // at most two contiguous areas
+  for (int i = 0; i < 2 && frames; i++) {
+    unsigned n = frames;
+    int16_t *dst = fmplayer_ring_write_begin(&spec->ring, &n);
+    if (!n) return;
+    memcpy(dst, buf, sizeof(buf[0]) * n * 2);
+    fmplayer_ring_write_commit(&spec->ring, n);
+    buf += n*2;
+    frames -= n;
+  }
+}
+
+void fmplayer_spectrum_write_tracks(struct fmplayer_spectrum *spec,
+                                    const struct oscillodata *tracks) {
+  if (!atomic_load_explicit(&spec->tracks_want, memory_order_acquire)) return;
+  memcpy(spec->tracks_in, tracks, sizeof(spec->tracks_in));
+  atomic_store_explicit(&spec->tracks_want, false, memory_order_release);
+}
+
+bool fmplayer_spectrum_run(struct fmplayer_spectrum *spec) {
+  int16_t buf[READ_FRAMES*2];
+  bool due = false;
+  unsigned frames;
+  while ((frames = fmplayer_ring_read(&spec->ring, buf, READ_FRAMES))) {
+    fft_write(&spec->idata.fdata, buf, frames);
+    spec->pending += frames;
+    if (spec->pending >= spec->hop) {
+      spec->pending %= spec->hop;
+      due = true;
+    }
+  }
+  if (due) fft_calc(&spec->cur.mix, &spec->idata);
+  if (!atomic_load_explicit(&spec->tracks_want, memory_order_acquire)) {
+    fft_calc_tracks(spec->cur.tracks, spec->tracks_in,
+                    FMPLAYER_SPECTRUM_TRACKS, &spec->tracks_work);
+    atomic_store_explicit(&spec->tracks_want, true, memory_order_release);
+    due = true;
+  }
+  if (!due) return false;
+  spec->disp[spec->triple.back] = spec->cur;
+  fmplayer_triple_publish(&spec->triple);
+  return true;
+}
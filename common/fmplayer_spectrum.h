@@ -0,0 +1,61 @@
+#ifndef MYON_FMPLAYER_SPECTRUM_H_INCLUDED
+#define MYON_FMPLAYER_SPECTRUM_H_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "common/fmplayer_ring.h"
+#include "common/fmplayer_triple.h"
+#include "fft/fft.h"
+
+enum {
+  // FM 1-6, SSG 1-3, libopna does not tap the rhythm and adpcm
+  FMPLAYER_SPECTRUM_TRACKS = 9,
+};
+
+struct fmplayer_spectrum_disp {
+  struct fmplayer_fft_disp_data mix;
+  struct fmplayer_fft_disp_data tracks[FMPLAYER_SPECTRUM_TRACKS];
+};
+
+// spectrum analyzer for a worker thread
+// the audio callback hands the output over through a lock-free ring,
+// the worker transforms the last FFTLEN samples every hop frames,
+// and the display reads the latest result through a triple buffer
+// per track spectra are computed from the oscilloscope tracks
+// when the synthesis thread hands them over
+struct fmplayer_spectrum {
+  struct fmplayer_ring ring;
+  unsigned hop;
+  // set by the worker when tracks_in can be overwritten
+  atomic_bool tracks_want;
+  struct oscillodata tracks_in[FMPLAYER_SPECTRUM_TRACKS];
+  // only touched by the worker
+  unsigned pending;
+  struct fmplayer_fft_input_data idata;
+  struct fmplayer_fft_tracks_work tracks_work;
+  struct fmplayer_spectrum_disp cur;
+  struct fmplayer_spectrum_disp disp[3];
+  struct fmplayer_triple triple;
+};
+
+// also initializes the fft tables
+bool fmplayer_spectrum_init(struct fmplayer_spectrum *spec, unsigned hop);
+void fmplayer_spectrum_deinit(struct fmplayer_spectrum *spec);
+// audio callback: frames that do not fit in the ring are dropped
+void fmplayer_spectrum_write(struct fmplayer_spectrum *spec,
+                             const int16_t *buf, unsigned frames);
+// synthesis thread: tracks are the oscilloscope tracks of opna_mix_oscillo
+// copied only when the worker finished the previous ones
+void fmplayer_spectrum_write_tracks(struct fmplayer_spectrum *spec,
+                                    const struct oscillodata *tracks);
+// worker: consumes the ring, returns true if a new spectrum was published
+// when more than one hop is pending only the latest window is transformed
+bool fmplayer_spectrum_run(struct fmplayer_spectrum *spec);
+
+// display: the latest published spectrum
+static inline const struct fmplayer_spectrum_disp *fmplayer_spectrum_read(
+    struct fmplayer_spectrum *spec) {
+  return &spec->disp[fmplayer_triple_read(&spec->triple, 0)];
+}
+
+#endif // MYON_FMPLAYER_SPECTRUM_H_INCLUDED
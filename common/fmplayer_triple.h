@@ -0,0 +1,61 @@
+#ifndef MYON_FMPLAYER_TRIPLE_H_INCLUDED
+#define MYON_FMPLAYER_TRIPLE_H_INCLUDED
+
+#include <stdbool.h>
+#if defined(_MSC_VER) && !defined(__cplusplus)
+#include "stdatomic.h"
+#else
+#include <stdatomic.h>
+#endif
+
+// index management of a triple buffer between one writer and one reader
+// the caller owns the 3 buffers, neither side ever waits:
+// the writer fills back and publishes it, the reader takes the latest
+// published buffer as front
+struct fmplayer_triple {
+  // index of the middle buffer, with FMPLAYER_TRIPLE_FRESH when
+  // it was published after the last fmplayer_triple_read
+  atomic_uint mid;
+  // only touched by the writer
+  unsigned back;
+  // back was published before and the reader never took it
+  bool dropped;
+  // only touched by the reader
+  unsigned front;
+};
+
+enum {
+  FMPLAYER_TRIPLE_FRESH = 4,
+};
+
+static inline void fmplayer_triple_init(struct fmplayer_triple *t) {
+  t->back = 0;
+  t->dropped = false;
+  atomic_init(&t->mid, 1);
+  t->front = 2;
+}
+
+// writer: swaps the filled back buffer in, returns the new back buffer
+static inline unsigned fmplayer_triple_publish(struct fmplayer_triple *t) {
+  unsigned mid = atomic_exchange_explicit(
+      &t->mid, t->back | FMPLAYER_TRIPLE_FRESH, memory_order_acq_rel);
+  t->back = mid & 3;
+  t->dropped = mid & FMPLAYER_TRIPLE_FRESH;
+  return t->back;
+}
+
+// reader: returns the latest published buffer,
+// *fresh (can be 0) is set if it changed since the last call
+static inline unsigned fmplayer_triple_read(struct fmplayer_triple *t,
+                                            bool *fresh) {
+  bool f = atomic_load_explicit(&t->mid, memory_order_relaxed)
+           & FMPLAYER_TRIPLE_FRESH;
+  if (f) {
+    t->front = atomic_exchange_explicit(
+        &t->mid, t->front, memory_order_acq_rel) & 3;
+  }
+  if (fresh) *fresh = f;
+  return t->front;
+}
+
+#endif // MYON_FMPLAYER_TRIPLE_H_INCLUDED
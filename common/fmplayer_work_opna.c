@@ -40,6 +40,11 @@ static void opna_mix_cb(void *userptr, int16_t *buf, unsigned samples) {
   ppz8_mix(ppz8, buf, samples);
 }
 
+static void opna_skip_cb(void *userptr, unsigned samples) {
+  struct ppz8 *ppz8 = (struct ppz8 *)userptr;
+  ppz8_skip(ppz8, samples);
+}
+
 void fmplayer_init_work_opna(
   struct fmdriver_work *work,
   struct ppz8 *ppz8,
@@ -61,4 +66,5 @@ void fmplayer_init_work_opna(
   work->ppz8_functbl = &ppz8_functbl;
   opna_timer_set_int_callback(timer, opna_int_cb, work);
   opna_timer_set_mix_callback(timer, opna_mix_cb, ppz8);
+  opna_timer_set_skip_callback(timer, opna_skip_cb);
 }
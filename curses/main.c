@@ -6,6 +6,8 @@
 #include "libopna/opnatimer.h"
 #include "fmdriver/fmdriver.h"
 #include "fmdriver/fmdriver_fmp.h"
+#include "common/fmplayer_checkpoint.h"
+#include "common/fmplayer_s98log.h"
 #include <portaudio.h>
 #include <stdlib.h>
 #include <locale.h>
@@ -18,8 +20,10 @@
 #endif
 
 static uint8_t g_data[0x10000];
+static struct fmplayer_checkpoint_index g_checkpoints;
 enum {
   SRATE = 55467,
+  SEEK_SEC = 5,
 };
 
 #ifdef HAVE_SAMPLERATE
@@ -119,6 +123,11 @@ static void opna_mix_callback(void *userptr, int16_t *buf, unsigned samples) {
   ppz8_mix(ppz8, buf, samples);
 }
 
+static void opna_skip_callback(void *userptr, unsigned samples) {
+  struct ppz8 *ppz8 = (struct ppz8 *)userptr;
+  ppz8_skip(ppz8, samples);
+}
+
 static const char *notestr[12] = {
   "c ",
   "c+",
@@ -353,7 +362,9 @@ static bool readrom(struct opna *opna) {
   if (fseek(rhythm, 0, SEEK_SET) != 0) goto err_file;
   uint8_t data[0x2000];
   if (fread(data, 1, 0x2000, rhythm) != 0x2000) goto err_file;
-  opna_drum_set_rom(&opna->drum, data);
+  static struct opna_drum_rom drumrom;
+  opna_drum_rom_decode(&drumrom, data);
+  opna_drum_set_rom(&opna->drum, &drumrom);
   fclose(rhythm);
   return true;
 err_file:
@@ -500,6 +511,39 @@ static void list_devices(void) {
   exit(0);
 }
 
+static int s98_export(struct opna_timer *timer,
+                      struct fmplayer_s98log *log,
+                      const char *path) {
+  enum {
+    S98_MAX_FRAMES = SRATE*60*30,
+  };
+  uint64_t frames = 0;
+  while (!log->done && frames < S98_MAX_FRAMES) {
+    opna_timer_skip(timer, 1024);
+    frames += 1024;
+  }
+  size_t s98len;
+  void *s98data = fmplayer_s98log_finish(log, &s98len);
+  if (!s98data) {
+    fprintf(stderr, "cannot allocate memory for S98 data\n");
+    return 1;
+  }
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    fprintf(stderr, "cannot open S98 file\n");
+    free(s98data);
+    return 1;
+  }
+  bool ok = fwrite(s98data, 1, s98len, file) == s98len;
+  ok = !fclose(file) && ok;
+  free(s98data);
+  if (!ok) {
+    fprintf(stderr, "cannot write S98 file\n");
+    return 1;
+  }
+  return 0;
+}
+
 static void help(const char *name) {
   fprintf(stderr, "Usage: %s [options] file\n", name);
   fprintf(stderr, "currently supported files: FMP(PLAY6)\n");
@@ -507,6 +551,7 @@ static void help(const char *name) {
   fprintf(stderr, "  -h        show help\n");
   fprintf(stderr, "  -l        list portaudio devices\n");
   fprintf(stderr, "  -d index  specify device number\n");
+  fprintf(stderr, "  -s file   write S98 register log and exit\n");
   exit(1);
 }
 
@@ -517,7 +562,8 @@ int main(int argc, char **argv) {
   }
   int optchar;
   PaDeviceIndex pi = Pa_GetDefaultOutputDevice();
-  while ((optchar = getopt(argc, argv, "hld:")) != -1) {
+  const char *s98path = 0;
+  while ((optchar = getopt(argc, argv, "hld:s:")) != -1) {
     switch (optchar) {
     case 'l':
       list_devices();
@@ -525,6 +571,9 @@ int main(int argc, char **argv) {
     case 'd':
       pi = atoi(optarg);
       break;
+    case 's':
+      s98path = optarg;
+      break;
     default:
     case 'h':
       help(argv[0]);
@@ -585,6 +634,7 @@ int main(int argc, char **argv) {
   
   opna_timer_set_int_callback(&timer, opna_interrupt_callback, &work);
   opna_timer_set_mix_callback(&timer, opna_mix_callback, &ppz8);
+  opna_timer_set_skip_callback(&timer, opna_skip_callback);
   work.opna_writereg = opna_writereg_libopna;
   work.opna_status = opna_status_libopna;
   work.opna = &timer;
@@ -592,9 +642,19 @@ int main(int argc, char **argv) {
     fprintf(stderr, "not fmp\n");
     return 1;
   }
+  static struct fmplayer_s98log s98log;
+  if (s98path && !fmplayer_s98log_init(&s98log, &work, &timer)) {
+    fprintf(stderr, "cannot allocate memory for S98 data\n");
+    return 1;
+  }
   fmp_init(&work, &fmp);
   bool pvi_loaded = loadpvi(&work, &fmp, filename);
   bool ppz_loaded = loadppzpvi(&work, &fmp, filename);
+  if (s98path) return s98_export(&timer, &s98log, s98path);
+  fmplayer_checkpoint_init(&g_checkpoints, &work, &timer, &ppz8,
+                           sizeof(fmp), g_data, filelen);
+  // the checkpoints copy the whole state, not on the audio callback
+  fmplayer_checkpoint_build(&g_checkpoints);
 
   PaStream *ps;
   PaError pe;
@@ -654,6 +714,7 @@ int main(int argc, char **argv) {
   clear();
   refresh();
   curs_set(0);
+  keypad(stdscr, TRUE);
 
   timeout(20);
 
@@ -706,7 +767,8 @@ int main(int argc, char **argv) {
   int cont = 1;
   bool pause = 0;
   while (cont) {
-    switch (getch()) {
+    int c = getch();
+    switch (c) {
     case 'q':
       cont = 0;
       break;
@@ -718,6 +780,22 @@ int main(int argc, char **argv) {
         Pa_StartStream(ps);
       }
       break;
+    case KEY_LEFT:
+    case KEY_RIGHT:
+      {
+        // stop the callback while restoring
+        if (!pause) Pa_AbortStream(ps);
+        uint32_t ticks = fmplayer_checkpoint_sec_ticks(&g_checkpoints, SEEK_SEC);
+        uint32_t pos = work.timerb_cnt;
+        if (c == KEY_RIGHT) {
+          pos += ticks;
+        } else {
+          pos = (pos > ticks) ? pos - ticks : 0;
+        }
+        fmplayer_checkpoint_seek(&g_checkpoints, pos);
+        if (!pause) Pa_StartStream(ps);
+      }
+      break;
     case ERR:
       update(&ppz8, &opna, &fmp);
       break;
@@ -1,6 +1,19 @@
 #include "fft.h"
 #include <math.h>
 #include <string.h>
+#include <stdbool.h>
+#if defined(_MSC_VER) && !defined(__cplusplus)
+#include "stdatomic.h"
+#else
+#include <stdatomic.h>
+#endif
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FFT_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FFT_NEON
+#endif
 
 void fft_write(struct fmplayer_fft_data *data, const int16_t *buf, unsigned len) {
   if (len > FFTLEN) {
@@ -37,111 +50,155 @@ static const uint16_t fftfreqtab[FFTDISPLEN+1] = {
 enum {
   HFFTLENBIT = 12,
   HFFTLEN = 1<<HFFTLENBIT,
+  // highest bin used by the display
+  FFTMAXBIN = 1009,
 };
 
-static uint16_t window[FFTLEN];
-static float tritab[FFTLEN + FFTLEN/4];
+// shared by all players, read-only once table.ready is set
+static struct {
+  atomic_flag lock;
+  atomic_bool ready;
+} table = {
+  .lock = ATOMIC_FLAG_INIT,
+};
+// window / 32768
+static float window[FFTLEN];
+static uint16_t bitrev[HFFTLEN];
+// twiddles of the complex transform,
+// exp(-2pi i j / (2h)) for the stage of half size h at [h+j]
+static float twre[HFFTLEN];
+static float twim[HFFTLEN];
+// exp(-2pi i k / FFTLEN) to split the real transform
+static float rtwre[FFTMAXBIN];
+static float rtwim[FFTMAXBIN];
 
-void fft_init_table(void) {
+static void fft_calc_table(void) {
   const double pi = acos(0.0) * 2.0;
   double alpha = 0.54;
   double beta = 1.0 - alpha;
   for (unsigned i = 0; i < FFTLEN; i++) {
     double v = alpha - beta * cos(2.0*pi*i/(FFTLEN-1));
-    window[i] = v * (1<<16);
+    window[i] = v / 32768.0;
   }
-  for (unsigned i = 0; i < (FFTLEN + FFTLEN/4); i++) {
-    tritab[i] = sin(2.0*pi*i/FFTLEN);
-  }
-}
-
-static float coscalc(unsigned i) {
-  return tritab[(i & (FFTLEN-1)) + FFTLEN/4];
-}
-
-static float sincalc(unsigned i) {
-  return tritab[i & (FFTLEN-1)];
-}
-
-static float ar(unsigned i) {
-  return 0.5f*(1.0f-sincalc(i));
-}
-
-static float ai(unsigned i) {
-  return -0.5f*coscalc(i);
-}
-
-static float br(unsigned i) {
-  return 0.5f*(1.0f+sincalc(i));
-}
-
-static float bi(unsigned i) {
-  return 0.5f*coscalc(i);
-}
-
-static void fft_real(float *fftbuf) {
-  unsigned b = 0;
   for (unsigned i = 0; i < HFFTLEN; i++) {
     unsigned ii = 0;
     for (unsigned bit = 0; bit < HFFTLENBIT; bit++) {
       ii |= ((i >> bit) & 1u) << (HFFTLENBIT-bit-1);
     }
-    fftbuf[(!b)*FFTLEN+i*2+0] = fftbuf[b*FFTLEN+ii*2+0];
-    fftbuf[(!b)*FFTLEN+i*2+1] = fftbuf[b*FFTLEN+ii*2+1];
-  }
-  b = !b;
-  for (unsigned bit = 0; bit < HFFTLENBIT; bit++) {
-    for (unsigned i = 0; i < HFFTLEN; i++) {
-      unsigned ei = i & ~(1u<<bit);
-      unsigned oi = i | (1u<<bit);
-      float are = fftbuf[b*FFTLEN+oi*2+0];
-      float aim = fftbuf[b*FFTLEN+oi*2+1];
-      float bre = coscalc(i<<(HFFTLENBIT-bit));
-      float bim = sincalc(i<<(HFFTLENBIT-bit));
-      float cre = are*bre - aim*bim;
-      float cim = are*bim + aim*bre;
-      fftbuf[(!b)*FFTLEN+i*2+0] = fftbuf[b*FFTLEN+ei*2+0] + cre;
-      fftbuf[(!b)*FFTLEN+i*2+1] = fftbuf[b*FFTLEN+ei*2+1] + cim;
+    bitrev[i] = ii;
+  }
+  for (unsigned h = 1; h < HFFTLEN; h <<= 1) {
+    for (unsigned j = 0; j < h; j++) {
+      twre[h+j] = cos(pi*j/h);
+      twim[h+j] = -sin(pi*j/h);
     }
-    b = !b;
   }
-  for (unsigned i = 0; i < HFFTLEN; i++) {
-    float xr = fftbuf[b*FFTLEN+i*2+0];
-    float rxr = fftbuf[b*FFTLEN+0];
-    if (i) rxr = fftbuf[b*FFTLEN+(HFFTLEN-i)*2+0];
-    float xi = fftbuf[b*FFTLEN+i*2+1];
-    float rxi = fftbuf[b*FFTLEN+1];
-    if (i) rxi = fftbuf[b*FFTLEN+(HFFTLEN-i)*2+1];
-    fftbuf[(!b)*FFTLEN+i*2+0] = xr * ar(i) - xi * ai(i) + rxr * br(i) + rxi * bi(i);
-    fftbuf[(!b)*FFTLEN+i*2+1] = xi * ar(i) + xr * ai(i) + rxr * bi(i) - rxi * br(i);
-  }
-  if (!b) {
-    memcpy(fftbuf, fftbuf+FFTLEN, FFTLEN*sizeof(fftbuf[0]));
+  for (unsigned k = 0; k < FFTMAXBIN; k++) {
+    rtwre[k] = cos(2.0*pi*k/FFTLEN);
+    rtwim[k] = -sin(2.0*pi*k/FFTLEN);
   }
 }
 
-void fft_calc(struct fmplayer_fft_disp_data *ddata, struct fmplayer_fft_input_data *idata) {
-  for (int i = 0; i < FFTLEN; i++) {
-    int fi = (i + idata->fdata.ind) % FFTLEN;
-    idata->work[i] = (((int32_t)idata->fdata.buf[fi]) * window[i]) >> 16;
+void fft_init_table(void) {
+  if (atomic_load_explicit(&table.ready, memory_order_acquire)) return;
+  while (atomic_flag_test_and_set_explicit(&table.lock, memory_order_acquire));
+  if (!atomic_load_explicit(&table.ready, memory_order_relaxed)) {
+    fft_calc_table();
+    atomic_store_explicit(&table.ready, true, memory_order_release);
+  }
+  atomic_flag_clear_explicit(&table.lock, memory_order_release);
+}
+
+// butterflies of one stage with half size h >= 4
+static void fft_stage(float *re, float *im, unsigned h) {
+  const float *wre = twre + h;
+  const float *wim = twim + h;
+  for (unsigned base = 0; base < HFFTLEN; base += h*2) {
+    float *are = re + base, *aim = im + base;
+    float *bre = are + h, *bim = aim + h;
+#if defined(FFT_SSE)
+    for (unsigned j = 0; j < h; j += 4) {
+      __m128 xr = _mm_loadu_ps(bre+j);
+      __m128 xi = _mm_loadu_ps(bim+j);
+      __m128 wr = _mm_loadu_ps(wre+j);
+      __m128 wi = _mm_loadu_ps(wim+j);
+      __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, wr), _mm_mul_ps(xi, wi));
+      __m128 ti = _mm_add_ps(_mm_mul_ps(xr, wi), _mm_mul_ps(xi, wr));
+      __m128 ar = _mm_loadu_ps(are+j);
+      __m128 ai = _mm_loadu_ps(aim+j);
+      _mm_storeu_ps(bre+j, _mm_sub_ps(ar, tr));
+      _mm_storeu_ps(bim+j, _mm_sub_ps(ai, ti));
+      _mm_storeu_ps(are+j, _mm_add_ps(ar, tr));
+      _mm_storeu_ps(aim+j, _mm_add_ps(ai, ti));
+    }
+#elif defined(FFT_NEON)
+    for (unsigned j = 0; j < h; j += 4) {
+      float32x4_t xr = vld1q_f32(bre+j);
+      float32x4_t xi = vld1q_f32(bim+j);
+      float32x4_t wr = vld1q_f32(wre+j);
+      float32x4_t wi = vld1q_f32(wim+j);
+      float32x4_t tr = vmlsq_f32(vmulq_f32(xr, wr), xi, wi);
+      float32x4_t ti = vmlaq_f32(vmulq_f32(xr, wi), xi, wr);
+      float32x4_t ar = vld1q_f32(are+j);
+      float32x4_t ai = vld1q_f32(aim+j);
+      vst1q_f32(bre+j, vsubq_f32(ar, tr));
+      vst1q_f32(bim+j, vsubq_f32(ai, ti));
+      vst1q_f32(are+j, vaddq_f32(ar, tr));
+      vst1q_f32(aim+j, vaddq_f32(ai, ti));
+    }
+#else
+    for (unsigned j = 0; j < h; j++) {
+      float tr = bre[j]*wre[j] - bim[j]*wim[j];
+      float ti = bre[j]*wim[j] + bim[j]*wre[j];
+      bre[j] = are[j] - tr;
+      bim[j] = aim[j] - ti;
+      are[j] += tr;
+      aim[j] += ti;
+    }
+#endif
   }
-  for (int i = 0; i < FFTLEN; i++) {
-    idata->fwork[i] = ((float)idata->work[i])/32768;
+}
+
+// in place complex transform of HFFTLEN points in bit reversed order
+static void fft_complex(float *re, float *im) {
+  // the first two stages as radix 4, twiddles are 1 and -i
+  for (unsigned base = 0; base < HFFTLEN; base += 4) {
+    float *r = re + base, *i = im + base;
+    float a0r = r[0] + r[1], a0i = i[0] + i[1];
+    float a1r = r[0] - r[1], a1i = i[0] - i[1];
+    float a2r = r[2] + r[3], a2i = i[2] + i[3];
+    float a3r = r[2] - r[3], a3i = i[2] - i[3];
+    r[0] = a0r + a2r; i[0] = a0i + a2i;
+    r[2] = a0r - a2r; i[2] = a0i - a2i;
+    r[1] = a1r + a3i; i[1] = a1i - a3r;
+    r[3] = a1r - a3i; i[3] = a1i + a3r;
   }
-  fft_real(idata->fwork);
-  for (int i = 1; i < FFTLEN/2; i++) {
-    float re = idata->fwork[i*2];
-    float im = idata->fwork[i*2+1];
-    idata->fwork[i] = sqrtf((re*re) + (im*im));
+  for (unsigned h = 4; h < HFFTLEN; h <<= 1) {
+    fft_stage(re, im, h);
   }
-  for (int i = 0; i < FFTLEN/2; i++) {
-    idata->fwork[i] = idata->fwork[i] / sqrtf(FFTLEN);
+}
+
+// splits the real transform and converts the displayed bins
+// element k of the complex transform is at re[k*stride], im[k*stride]
+static void fft_disp(struct fmplayer_fft_disp_data *ddata,
+                     const float *re, const float *im, unsigned stride) {
+  float mag[FFTMAXBIN];
+  const float scale = 0.5f / sqrtf(FFTLEN);
+  // dc: the sum of the even and odd halves, without the halving
+  mag[0] = fabsf(re[0] + im[0]) * 2.0f * scale;
+  for (unsigned k = 1; k < FFTMAXBIN; k++) {
+    unsigned fk = k*stride, rk = (HFFTLEN - k)*stride;
+    float er = re[fk] + re[rk], ei = im[fk] - im[rk];
+    float orr = im[fk] + im[rk], ori = re[rk] - re[fk];
+    float xr = er + orr*rtwre[k] - ori*rtwim[k];
+    float xi = ei + orr*rtwim[k] + ori*rtwre[k];
+    mag[k] = sqrtf(xr*xr + xi*xi) * scale;
   }
   float dbuf[FFTDISPLEN];
   for (int i = 0; i < FFTDISPLEN; i++) {
     dbuf[i] = 0.0f;
     for (int j = fftfreqtab[i]; j < fftfreqtab[i+1]; j++) {
-      dbuf[i] += idata->fwork[j];
+      dbuf[i] += mag[j];
     }
     dbuf[i] /= fftfreqtab[i+1] - fftfreqtab[i];
   }
@@ -152,3 +209,145 @@ void fft_calc(struct fmplayer_fft_disp_data *ddata, struct fmplayer_fft_input_da
     ddata->buf[i] = res;
   }
 }
+
+// buf: ring of FFTLEN samples starting at ind
+// re, im: HFFTLEN floats each
+static void fft_calc_ring(struct fmplayer_fft_disp_data *ddata,
+                          const int16_t *buf, unsigned ind,
+                          float *re, float *im) {
+  // unwrap the ring, window, and pack even/odd samples as a complex
+  // sequence in bit reversed order
+  for (unsigned k = 0; k < HFFTLEN; k++) {
+    unsigned i = k*2;
+    re[bitrev[k]] = buf[(ind+i) & (FFTLEN-1)] * window[i];
+    im[bitrev[k]] = buf[(ind+i+1) & (FFTLEN-1)] * window[i+1];
+  }
+  fft_complex(re, im);
+  fft_disp(ddata, re, im, 1);
+}
+
+void fft_calc(struct fmplayer_fft_disp_data *ddata, struct fmplayer_fft_input_data *idata) {
+  fft_calc_ring(ddata, idata->fdata.buf, idata->fdata.ind,
+                idata->fwork, idata->fwork + HFFTLEN);
+}
+
+// FFT_LANES transforms interleaved, element k of lane l at [k*FFT_LANES+l]
+// every lane uses the same twiddle, so one vector covers all lanes
+#if defined(FFT_SSE)
+typedef __m128 fft_vec;
+#define VLOAD(p) _mm_loadu_ps(p)
+#define VSTORE(p, v) _mm_storeu_ps(p, v)
+#define VSET1(f) _mm_set1_ps(f)
+#define VADD(a, b) _mm_add_ps(a, b)
+#define VSUB(a, b) _mm_sub_ps(a, b)
+#define VMUL(a, b) _mm_mul_ps(a, b)
+#elif defined(FFT_NEON)
+typedef float32x4_t fft_vec;
+#define VLOAD(p) vld1q_f32(p)
+#define VSTORE(p, v) vst1q_f32(p, v)
+#define VSET1(f) vdupq_n_f32(f)
+#define VADD(a, b) vaddq_f32(a, b)
+#define VSUB(a, b) vsubq_f32(a, b)
+#define VMUL(a, b) vmulq_f32(a, b)
+#else
+typedef struct { float v[FFT_LANES]; } fft_vec;
+static inline fft_vec fft_vload(const float *p) {
+  fft_vec r;
+  for (int l = 0; l < FFT_LANES; l++) r.v[l] = p[l];
+  return r;
+}
+static inline void fft_vstore(float *p, fft_vec a) {
+  for (int l = 0; l < FFT_LANES; l++) p[l] = a.v[l];
+}
+static inline fft_vec fft_vset1(float f) {
+  fft_vec r;
+  for (int l = 0; l < FFT_LANES; l++) r.v[l] = f;
+  return r;
+}
+#define FFT_VOP(name, op) \
+static inline fft_vec name(fft_vec a, fft_vec b) { \
+  for (int l = 0; l < FFT_LANES; l++) a.v[l] = a.v[l] op b.v[l]; \
+  return a; \
+}
+FFT_VOP(fft_vadd, +)
+FFT_VOP(fft_vsub, -)
+FFT_VOP(fft_vmul, *)
+#undef FFT_VOP
+#define VLOAD(p) fft_vload(p)
+#define VSTORE(p, v) fft_vstore(p, v)
+#define VSET1(f) fft_vset1(f)
+#define VADD(a, b) fft_vadd(a, b)
+#define VSUB(a, b) fft_vsub(a, b)
+#define VMUL(a, b) fft_vmul(a, b)
+#endif
+
+static void fft_complex_multi(float *re, float *im) {
+  enum { L = FFT_LANES };
+  for (unsigned base = 0; base < HFFTLEN*L; base += 4*L) {
+    float *r = re + base, *i = im + base;
+    fft_vec r0 = VLOAD(r+0*L), r1 = VLOAD(r+1*L);
+    fft_vec r2 = VLOAD(r+2*L), r3 = VLOAD(r+3*L);
+    fft_vec i0 = VLOAD(i+0*L), i1 = VLOAD(i+1*L);
+    fft_vec i2 = VLOAD(i+2*L), i3 = VLOAD(i+3*L);
+    fft_vec a0r = VADD(r0, r1), a0i = VADD(i0, i1);
+    fft_vec a1r = VSUB(r0, r1), a1i = VSUB(i0, i1);
+    fft_vec a2r = VADD(r2, r3), a2i = VADD(i2, i3);
+    fft_vec a3r = VSUB(r2, r3), a3i = VSUB(i2, i3);
+    VSTORE(r+0*L, VADD(a0r, a2r)); VSTORE(i+0*L, VADD(a0i, a2i));
+    VSTORE(r+2*L, VSUB(a0r, a2r)); VSTORE(i+2*L, VSUB(a0i, a2i));
+    VSTORE(r+1*L, VADD(a1r, a3i)); VSTORE(i+1*L, VSUB(a1i, a3r));
+    VSTORE(r+3*L, VSUB(a1r, a3i)); VSTORE(i+3*L, VADD(a1i, a3r));
+  }
+  for (unsigned h = 4; h < HFFTLEN; h <<= 1) {
+    for (unsigned base = 0; base < HFFTLEN; base += h*2) {
+      float *are = re + base*L, *aim = im + base*L;
+      float *bre = are + h*L, *bim = aim + h*L;
+      for (unsigned j = 0; j < h; j++) {
+        fft_vec wr = VSET1(twre[h+j]), wi = VSET1(twim[h+j]);
+        fft_vec xr = VLOAD(bre+j*L), xi = VLOAD(bim+j*L);
+        fft_vec tr = VSUB(VMUL(xr, wr), VMUL(xi, wi));
+        fft_vec ti = VADD(VMUL(xr, wi), VMUL(xi, wr));
+        fft_vec ar = VLOAD(are+j*L), ai = VLOAD(aim+j*L);
+        VSTORE(bre+j*L, VSUB(ar, tr));
+        VSTORE(bim+j*L, VSUB(ai, ti));
+        VSTORE(are+j*L, VADD(ar, tr));
+        VSTORE(aim+j*L, VADD(ai, ti));
+      }
+    }
+  }
+}
+
+void fft_calc_tracks(struct fmplayer_fft_disp_data *ddata,
+                     const struct oscillodata *tracks, unsigned cnt,
+                     struct fmplayer_fft_tracks_work *work) {
+  enum { L = FFT_LANES };
+  unsigned t = 0;
+  for (; t + L <= cnt; t += L) {
+    const int16_t *src[L];
+    unsigned head[L];
+    for (unsigned l = 0; l < L; l++) {
+      src[l] = tracks[t+l].buf;
+      head[l] = tracks[t+l].head;
+    }
+    // sequential writes, bit reversal is its own inverse
+    for (unsigned d = 0; d < HFFTLEN; d++) {
+      unsigned i = bitrev[d]*2;
+      float *re = work->re + d*L;
+      float *im = work->im + d*L;
+      for (unsigned l = 0; l < L; l++) {
+        unsigned p = head[l] + i;
+        re[l] = src[l][p & (OSCILLO_SAMPLE_COUNT-1)] * window[i];
+        im[l] = src[l][(p+1) & (OSCILLO_SAMPLE_COUNT-1)] * window[i+1];
+      }
+    }
+    fft_complex_multi(work->re, work->im);
+    for (unsigned l = 0; l < L; l++) {
+      fft_disp(&ddata[t+l], work->re + l, work->im + l, L);
+    }
+  }
+  // the rest one by one rather than in partly empty lanes
+  for (; t < cnt; t++) {
+    fft_calc_ring(&ddata[t], tracks[t].buf, tracks[t].head,
+                  work->re, work->im);
+  }
+}
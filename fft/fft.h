@@ -2,10 +2,13 @@
 #define MYON_FMPLAYER_FFT_FFT_H_INCLUDED
 
 #include <stdint.h>
+#include "oscillo/oscillo.h"
 
 enum {
   FFTLEN = 8192,
   FFTDISPLEN = 70,
+  // transforms computed together by fft_calc_tracks
+  FFT_LANES = 4,
 };
 
 struct fmplayer_fft_data {
@@ -15,8 +18,6 @@ struct fmplayer_fft_data {
 
 struct fmplayer_fft_input_data {
   struct fmplayer_fft_data fdata;
-  int16_t work[FFTLEN];
-  double dwork[FFTLEN];
   float fwork[FFTLEN*2];
 };
 
@@ -26,10 +27,23 @@ struct fmplayer_fft_disp_data {
   uint8_t buf[FFTDISPLEN];
 };
 
+// can be called from each player, the tables are calculated once
 void fft_init_table(void);
 
 void fft_write(struct fmplayer_fft_data *data, const int16_t *buf, unsigned len);
 
 void fft_calc(struct fmplayer_fft_disp_data *ddata, struct fmplayer_fft_input_data *idata);
 
+struct fmplayer_fft_tracks_work {
+  float re[FFTLEN/2*FFT_LANES];
+  float im[FFTLEN/2*FFT_LANES];
+};
+
+// spectra of cnt oscilloscope tracks (OSCILLO_SAMPLE_COUNT == FFTLEN)
+// FFT_LANES tracks at a time are interleaved in one transform,
+// the remainder is transformed one by one
+void fft_calc_tracks(struct fmplayer_fft_disp_data *ddata,
+                     const struct oscillodata *tracks, unsigned cnt,
+                     struct fmplayer_fft_tracks_work *work);
+
 #endif // MYON_FMPLAYER_FFT_FFT_H_INCLUDED
@@ -138,6 +138,9 @@ struct fmdriver_work {
   // fm3ex part map
   bool playing;
   bool paused;
+  // do not update the driver status above on interrupts
+  // (fast-forward, loop length calculation)
+  bool status_disabled;
 };
 
 #endif // MYON_FMDRIVER_H_INCLUDED
@@ -2935,7 +2935,7 @@ static void fmp_timerb(struct fmdriver_work *work, struct driver_fmp *fmp) {
   if (!fmp->rhythm.status) {
     fmp_part_cmd_rhythm(work, fmp);
   }
-  fmp_work_status_update(work, fmp);
+  if (!work->status_disabled) fmp_work_status_update(work, fmp);
 }
 
 static void fmp_init_parts(struct fmdriver_work *work,
@@ -5905,7 +5905,7 @@ static void pmd_opna_interrupt(struct fmdriver_work *work) {
     }
   }
   // 3cc0
-  pmd_work_status_update(work, pmd);
+  if (!work->status_disabled) pmd_work_status_update(work, pmd);
 }
 
 /*
@@ -223,6 +223,20 @@ void ppz8_mix(struct ppz8 *ppz8, int16_t *buf, unsigned samples) {
   }
 }
 
+void ppz8_skip(struct ppz8 *ppz8, unsigned samples) {
+  for (int p = 0; p < 8; p++) {
+    struct ppz8_channel *channel = &ppz8->channel[p];
+    if (!channel->playing) continue;
+    struct ppz8_pcmbuf *buf = &ppz8->buf[channel->voice>>7];
+    struct ppz8_pcmvoice *voice = &buf->voice[channel->voice & 0x7f];
+    uint64_t ptrdiff = (((uint64_t)channel->freq * voice->origfreq) << 1) / ppz8->srate;
+    uint64_t newptr = channel->ptr + ptrdiff * samples;
+    channel->ptr = ppz8_loop(channel, newptr);
+    if (newptr != channel->ptr) channel->looped = true;
+    if (channel->ptr == (uint64_t)-1) channel->playing = false;
+  }
+}
+
 static int16_t calc_acc(int16_t acc, uint16_t adpcmd, uint8_t data) {
   data &= 0xf;
   int32_t acc_d = (((data&7)<<1)|1);
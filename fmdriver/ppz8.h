@@ -66,6 +66,8 @@ struct ppz8 {
 
 void ppz8_init(struct ppz8 *ppz8, uint16_t srate, uint16_t mix_volume);
 void ppz8_mix(struct ppz8 *ppz8, int16_t *buf, unsigned samples);
+// advance playback position without mixing
+void ppz8_skip(struct ppz8 *ppz8, unsigned samples);
 bool ppz8_pvi_load(struct ppz8 *ppz8, uint8_t buf,
                    const uint8_t *pvidata, uint32_t pvidatalen,
                    int16_t *decodebuf);
@@ -5,6 +5,8 @@
 #include "font.h"
 #include "version.h"
 #include "fft/fft.h"
+#include "common/fmplayer_spectrum.h"
+#include "common/fmplayer_snapshot.h"
 
 #include "fmdsp_sprites.h"
 #include <stdlib.h>
@@ -140,8 +142,9 @@ struct fmdsp_pacc {
   struct pacc_tex *tex_comment_tri;
   struct pacc_tex *tex_playing;
   struct pacc_buf *buf_font_7;
-  struct pacc_buf *buf_font_2, *buf_font_2_d;
-  struct pacc_buf *buf_font_1, *buf_font_1_d;
+  // static text and rects first, the dynamic part after buf_keep
+  struct pacc_buf *buf_font_2;
+  struct pacc_buf *buf_font_1;
   struct pacc_buf *buf_fontm_2, *buf_fontm_3;
   struct pacc_buf *buf_checker, *buf_checker_1;
   struct pacc_buf *buf_key_left;
@@ -150,7 +153,7 @@ struct fmdsp_pacc {
   struct pacc_buf *buf_key_bg;
   struct pacc_buf *buf_num;
   struct pacc_buf *buf_dt_sign;
-  struct pacc_buf *buf_solid_2, *buf_solid_2_d, *buf_solid_3, *buf_solid_3_d, *buf_solid_7, *buf_solid_7_d;
+  struct pacc_buf *buf_solid_2, *buf_solid_3, *buf_solid_7;
   struct pacc_buf *buf_vertical_2, *buf_vertical_3, *buf_vertical_7;
   struct pacc_buf *buf_horizontal_2_d, *buf_horizontal_3, *buf_horizontal_7_d;
   struct pacc_buf *buf_logo;
@@ -174,6 +177,14 @@ struct fmdsp_pacc {
   struct opna *opna;
   struct fmdriver_work *work;
   struct fmplayer_fft_input_data *fftin;
+  struct fmplayer_spectrum *spectrum;
+  struct fmplayer_snapshots *snapshots;
+  // taken from work and opna in render without snapshots
+  struct fmplayer_snapshot own_snap;
+  // drawn by render, 0 without work
+  const struct fmplayer_snapshot *snap;
+  // -1: mix
+  int spectrum_track;
   uint8_t curr_palette[FMDSP_PALETTE_COLORS*3];
   uint8_t target_palette[FMDSP_PALETTE_COLORS*3];
   uint8_t comment_tex_buf[PC98_W*CHECKER_H];
@@ -220,12 +231,8 @@ static struct pacc_tex *tex_from_font(
 static void fmdsp_pacc_deinit_buf(struct fmdsp_pacc *fp) {
   fp->pacc.buf_delete(fp->buf_font_1);
   fp->buf_font_1 = 0;
-  fp->pacc.buf_delete(fp->buf_font_1_d);
-  fp->buf_font_1_d = 0;
   fp->pacc.buf_delete(fp->buf_font_2);
   fp->buf_font_2 = 0;
-  fp->pacc.buf_delete(fp->buf_font_2_d);
-  fp->buf_font_2_d = 0;
   fp->pacc.buf_delete(fp->buf_font_7);
   fp->buf_font_7 = 0;
   fp->pacc.buf_delete(fp->buf_fontm_2);
@@ -252,16 +259,10 @@ static void fmdsp_pacc_deinit_buf(struct fmdsp_pacc *fp) {
   fp->buf_dt_sign = 0;
   fp->pacc.buf_delete(fp->buf_solid_2);
   fp->buf_solid_2 = 0;
-  fp->pacc.buf_delete(fp->buf_solid_2_d);
-  fp->buf_solid_2_d = 0;
   fp->pacc.buf_delete(fp->buf_solid_3);
   fp->buf_solid_3 = 0;
-  fp->pacc.buf_delete(fp->buf_solid_3_d);
-  fp->buf_solid_3_d = 0;
   fp->pacc.buf_delete(fp->buf_solid_7);
   fp->buf_solid_7 = 0;
-  fp->pacc.buf_delete(fp->buf_solid_7_d);
-  fp->buf_solid_7_d = 0;
   fp->pacc.buf_delete(fp->buf_vertical_2);
   fp->buf_vertical_2 = 0;
   fp->pacc.buf_delete(fp->buf_vertical_3);
@@ -468,7 +469,7 @@ static void update_track_without_key(
     struct fmdsp_pacc *fp,
     int t,
     int x, int y) {
-  const struct fmdriver_track_status *track = &fp->work->track_status[t];
+  const struct fmdriver_track_status *track = &fp->snap->track_status[t];
   int tracknum = track_type_table[t].num;
   int num1 = (tracknum/10) % 10;
   int num2 = tracknum % 10;
@@ -487,28 +488,28 @@ static void update_track_without_key(
     switch (track->info) {
     case FMDRIVER_TRACK_INFO_PPZ8:
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_2_d, x+TINFO_X, y+6, "PPZ8");
+          fp->pc, fp->buf_font_2, x+TINFO_X, y+6, "PPZ8");
       break;
     case FMDRIVER_TRACK_INFO_PDZF:
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_2_d, x+TINFO_X, y+6, "PDZF");
+          fp->pc, fp->buf_font_2, x+TINFO_X, y+6, "PDZF");
       break;
     case FMDRIVER_TRACK_INFO_SSGEFF:
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_2_d, x+TINFO_X+2, y, "EFF");
+          fp->pc, fp->buf_font_2, x+TINFO_X+2, y, "EFF");
       /* FALLTHRU */
     case FMDRIVER_TRACK_INFO_SSG:
       if (track->ssg_noise) {
         fp->pacc.buf_printf(
-            fp->pc, fp->buf_font_2_d, x+TINFO_X+2, y+6,
-            "%c%02X", track->ssg_tone ? 'M' : 'N', fp->work->ssg_noise_freq);
+            fp->pc, fp->buf_font_2, x+TINFO_X+2, y+6,
+            "%c%02X", track->ssg_tone ? 'M' : 'N', fp->snap->ssg_noise_freq);
       }
       break;
     case FMDRIVER_TRACK_INFO_FM3EX:
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_2_d, x+TINFO_X+5, y, "EX");
+          fp->pc, fp->buf_font_2, x+TINFO_X+5, y, "EX");
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_2_d, x+TINFO_X, y+6,
+          fp->pc, fp->buf_font_2, x+TINFO_X, y+6,
           "%c%c%c%c",
           track->fmslotmask[0] ? ' ' : '1',
           track->fmslotmask[1] ? ' ' : '2',
@@ -521,12 +522,12 @@ static void update_track_without_key(
   }
   if (!track->playing) {
     fp->pacc.buf_printf(
-        fp->pc, fp->buf_font_1_d,
+        fp->pc, fp->buf_font_1,
         x+TDETAIL_KN_V_X+5, y+6, "S");
   } else {
     if ((track->key & 0xf) == 0xf) {
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_1_d,
+          fp->pc, fp->buf_font_1,
           x+TDETAIL_KN_V_X+5, y+6, "R");
     } else {
       const char *keystr = "";
@@ -535,24 +536,24 @@ static void update_track_without_key(
       };
       if (keytable[track->key&0xf]) keystr = keytable[track->key&0xf];
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_1_d,
+          fp->pc, fp->buf_font_1,
           x+TDETAIL_KN_V_X, y+6, "o%d%s", track->key>>4, keystr);
     }
   }
   fp->pacc.buf_printf(
-      fp->pc, fp->buf_font_1_d,
+      fp->pc, fp->buf_font_1,
       x+TDETAIL_TN_V_X, y+6, "%03d", track->tonenum);
   fp->pacc.buf_printf(
-      fp->pc, fp->buf_font_1_d,
+      fp->pc, fp->buf_font_1,
       x+TDETAIL_VL_V_X, y+6, "%03d", track->volume);
   fp->pacc.buf_printf(
-      fp->pc, fp->buf_font_1_d,
+      fp->pc, fp->buf_font_1,
       x+TDETAIL_GT_V_X, y+6, "%03d", track->gate);
   fp->pacc.buf_printf(
-      fp->pc, fp->buf_font_1_d,
+      fp->pc, fp->buf_font_1,
       x+TDETAIL_DT_V_X, y+6, "%03d", (track->detune > 0) ? track->detune : -track->detune);
   fp->pacc.buf_printf(
-      fp->pc, fp->buf_font_1_d,
+      fp->pc, fp->buf_font_1,
       x+TDETAIL_M_V_X, y+6, "%s", track->status);
   int sign;
   if (!track->detune) sign = 0;
@@ -562,8 +563,8 @@ static void update_track_without_key(
       fp->pc, fp->buf_dt_sign,
       x+TDETAIL_DT_S_X, y+6+2, DT_SIGN_W, DT_SIGN_H, 0, DT_SIGN_H*sign);
   struct pacc_buf *buf_rect = (((track->key & 0xf) == 0xf) || fp->masked[t]) ?
-    fp->buf_solid_7_d : fp->buf_solid_2_d;
-  if (!track->playing) buf_rect = fp->buf_solid_3_d;
+    fp->buf_solid_7 : fp->buf_solid_2;
+  if (!track->playing) buf_rect = fp->buf_solid_3;
   struct pacc_buf *buf_vertical = (((track->key & 0xf) == 0xf) || fp->masked[t]) ?
     fp->buf_vertical_7 : fp->buf_vertical_2;
   if (!track->playing) buf_vertical = fp->buf_vertical_3;
@@ -579,10 +580,10 @@ static void update_track_without_key(
 
 static void update_track_info_fm(struct fmdsp_pacc *fp, int ch,
                                  const bool *slotmask, int x, int y) {
-  const struct opna_fm_channel *c = &fp->opna->fm.channel[ch];
+  const struct fmplayer_snapshot_fm *c = &fp->snap->fm[ch];
   for (int si = 0; si < 4; si++) {
     if (slotmask && slotmask[si]) continue;
-    const struct opna_fm_slot *s = &c->slot[si];
+    const struct fmplayer_snapshot_fm_slot *s = &c->slot[si];
     int level = s->tl << 5; // (0 - 4064)
     int envlevel = level + (s->env<<2);
     int leveld = (4096 - level) / 64; // (0 - 63)
@@ -613,26 +614,26 @@ static void update_track_info_fm(struct fmdsp_pacc *fp, int ch,
       break;
     }
     fp->pacc.buf_printf(
-        fp->pc, fp->buf_font_1_d,
+        fp->pc, fp->buf_font_1,
         x+130, y+si*6, "%s", envstr);
     fp->pacc.buf_printf(
-        fp->pc, fp->buf_font_1_d,
+        fp->pc, fp->buf_font_1,
         x+150, y+si*6, "%03X", s->env);
     if (slotmask) {
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_1_d,
-          x+170, y+si*6, "%04X", (si != 3) ? fp->opna->fm.ch3.fnum[si] : c->fnum);
+          fp->pc, fp->buf_font_1,
+          x+170, y+si*6, "%04X", (si != 3) ? fp->snap->fm3_fnum[si] : c->fnum);
     }
   }
   if (!slotmask) {
     fp->pacc.buf_printf(
-        fp->pc, fp->buf_font_1_d,
+        fp->pc, fp->buf_font_1,
         x+170, y, "%04X", c->fnum);
   }
 }
 
 static void update_track_info_ssg(struct fmdsp_pacc *fp, int ch, int x, int y) {
-  int envleveld = opna_ssg_channel_level(&fp->opna->ssg, ch);
+  int envleveld = fp->snap->ssg[ch].level;
   fp->pacc.buf_rect(fp->pc, fp->buf_vertical_3,
       x, y+2, 128, 4);
   fp->pacc.buf_rect(fp->pc, fp->buf_vertical_2,
@@ -640,29 +641,29 @@ static void update_track_info_ssg(struct fmdsp_pacc *fp, int ch, int x, int y) {
   fp->pacc.buf_rect(fp->pc, fp->buf_vertical_7,
       x, y+2, 64, 4);
   fp->pacc.buf_printf(
-      fp->pc, fp->buf_font_1_d,
-      x+170, y, " %03X", opna_ssg_tone_period(&fp->opna->ssg, ch));
+      fp->pc, fp->buf_font_1,
+      x+170, y, " %03X", fp->snap->ssg[ch].tone_period);
 }
 
 static void update_track_info_adpcm(struct fmdsp_pacc *fp, int x, int y) {
   fp->pacc.buf_printf(
-      fp->pc, fp->buf_font_1_d,
+      fp->pc, fp->buf_font_1,
       x, y, "VOL DELTA  START    PTR    END");
   fp->pacc.buf_printf(
-      fp->pc, fp->buf_font_1_d,
+      fp->pc, fp->buf_font_1,
       x, y+6, "%3d  %04X %06X %06X %06X",
-      fp->opna->adpcm.vol,
-      fp->opna->adpcm.delta,
-      fp->opna->adpcm.start<<5,
-      fp->opna->adpcm.ramptr<<5,
-      (fp->opna->adpcm.end+1)<<5);
+      fp->snap->adpcm.vol,
+      fp->snap->adpcm.delta,
+      fp->snap->adpcm.start<<5,
+      fp->snap->adpcm.ramptr<<5,
+      (fp->snap->adpcm.end+1)<<5);
 }
 
 static void update_track_info_ppz8(struct fmdsp_pacc *fp, int ch, int x, int y) {
-  if (!fp->work->ppz8) return;
-  const struct ppz8_channel *c = &fp->work->ppz8->channel[ch];
+  if (!fp->snap->ppz8_enabled) return;
+  const struct fmplayer_snapshot_ppz8 *c = &fp->snap->ppz8[ch];
   fp->pacc.buf_printf(
-      fp->pc, fp->buf_font_1_d,
+      fp->pc, fp->buf_font_1,
       x, y, "PAN VOL     FREQ      PTR      END    LOOPS    LOOPE");
   char panstr[5];
   if (c->pan) {
@@ -676,7 +677,7 @@ static void update_track_info_ppz8(struct fmdsp_pacc *fp, int ch, int x, int y)
     snprintf(panstr, sizeof(panstr), "--");
   }
   fp->pacc.buf_printf(
-      fp->pc, fp->buf_font_1_d,
+      fp->pc, fp->buf_font_1,
       x, y+6, " %2s %03d %08X %08X %08X %08X %08X",
       panstr,
       c->vol, c->freq,
@@ -690,7 +691,7 @@ static void update_track_info_13(struct fmdsp_pacc *fp, int x) {
     int t = track_table[it];
     if (t == FMDRIVER_TRACK_NUM) break;
     int tnum = track_type_table[t].num;
-    const struct fmdriver_track_status *track = &fp->work->track_status[t];
+    const struct fmdriver_track_status *track = &fp->snap->track_status[t];
     if (track->info == FMDRIVER_TRACK_INFO_PPZ8 ||
         track->info == FMDRIVER_TRACK_INFO_PDZF) {
       update_track_info_ppz8(fp, track->ppz8_ch - 1, x, TRACK_H_S*it);
@@ -714,7 +715,7 @@ static void update_track_13(struct fmdsp_pacc *fp, int x) {
   const uint8_t *track_table = track_disp_table_13;
   for (int it = 0; it < 13; it++) {
     int t = track_table[it];
-    const struct fmdriver_track_status *track = &fp->work->track_status[t];
+    const struct fmdriver_track_status *track = &fp->snap->track_status[t];
     update_track_without_key(fp, t, x, TRACK_H_S*it);
     for (int i = 0; i < KEY_OCTAVES; i++) {
       if (track->playing || track->info == FMDRIVER_TRACK_INFO_SSGEFF) {
@@ -744,7 +745,7 @@ static void update_track_info_10(struct fmdsp_pacc *fp, const uint8_t *track_tab
     int t = track_table[it];
     if (t == FMDRIVER_TRACK_NUM) break;
     int tnum = track_type_table[t].num;
-    const struct fmdriver_track_status *track = &fp->work->track_status[t];
+    const struct fmdriver_track_status *track = &fp->snap->track_status[t];
     if (track->info == FMDRIVER_TRACK_INFO_PPZ8 ||
         track->info == FMDRIVER_TRACK_INFO_PDZF) {
       update_track_info_ppz8(fp, track->ppz8_ch - 1, x, TRACK_H*it);
@@ -771,7 +772,7 @@ static void update_track_10(struct fmdsp_pacc *fp, const uint8_t *track_table, i
   for (int it = 0; it < 10; it++) {
     int t = track_table[it];
     if (t == FMDRIVER_TRACK_NUM) break;
-    const struct fmdriver_track_status *track = &fp->work->track_status[t];
+    const struct fmdriver_track_status *track = &fp->snap->track_status[t];
     update_track_without_key(fp, t, x, TRACK_H*it);
     for (int i = 0; i < KEY_OCTAVES; i++) {
       if (track->playing || track->info == FMDRIVER_TRACK_INFO_SSGEFF) {
@@ -983,14 +984,10 @@ err:
 }
 
 static bool fmdsp_pacc_init_buf(struct fmdsp_pacc *fp) {
-  fp->buf_font_1 = fp->pacc.gen_buf(fp->pc, fp->tex_font, pacc_buf_mode_static);
+  fp->buf_font_1 = fp->pacc.gen_buf(fp->pc, fp->tex_font, pacc_buf_mode_stream);
   if (!fp->buf_font_1) goto err;
-  fp->buf_font_1_d = fp->pacc.gen_buf(fp->pc, fp->tex_font, pacc_buf_mode_stream);
-  if (!fp->buf_font_1_d) goto err;
-  fp->buf_font_2 = fp->pacc.gen_buf(fp->pc, fp->tex_font, pacc_buf_mode_static);
+  fp->buf_font_2 = fp->pacc.gen_buf(fp->pc, fp->tex_font, pacc_buf_mode_stream);
   if (!fp->buf_font_2) goto err;
-  fp->buf_font_2_d = fp->pacc.gen_buf(fp->pc, fp->tex_font, pacc_buf_mode_stream);
-  if (!fp->buf_font_2_d) goto err;
   fp->buf_font_7 = fp->pacc.gen_buf(fp->pc, fp->tex_font, pacc_buf_mode_static);
   if (!fp->buf_font_7) goto err;
   fp->buf_fontm_2 = fp->pacc.gen_buf(fp->pc, fp->tex_fontm, pacc_buf_mode_static);
@@ -1015,18 +1012,12 @@ static bool fmdsp_pacc_init_buf(struct fmdsp_pacc *fp) {
   if (!fp->buf_num) goto err;
   fp->buf_dt_sign = fp->pacc.gen_buf(fp->pc, fp->tex_dt_sign, pacc_buf_mode_stream);
   if (!fp->buf_dt_sign) goto err;
-  fp->buf_solid_2 = fp->pacc.gen_buf(fp->pc, fp->tex_solid, pacc_buf_mode_static);
+  fp->buf_solid_2 = fp->pacc.gen_buf(fp->pc, fp->tex_solid, pacc_buf_mode_stream);
   if (!fp->buf_solid_2) goto err;
-  fp->buf_solid_2_d = fp->pacc.gen_buf(fp->pc, fp->tex_solid, pacc_buf_mode_stream);
-  if (!fp->buf_solid_2_d) goto err;
-  fp->buf_solid_3= fp->pacc.gen_buf(fp->pc, fp->tex_solid, pacc_buf_mode_static);
+  fp->buf_solid_3= fp->pacc.gen_buf(fp->pc, fp->tex_solid, pacc_buf_mode_stream);
   if (!fp->buf_solid_3) goto err;
-  fp->buf_solid_3_d = fp->pacc.gen_buf(fp->pc, fp->tex_solid, pacc_buf_mode_stream);
-  if (!fp->buf_solid_3_d) goto err;
-  fp->buf_solid_7 = fp->pacc.gen_buf(fp->pc, fp->tex_solid, pacc_buf_mode_static);
+  fp->buf_solid_7 = fp->pacc.gen_buf(fp->pc, fp->tex_solid, pacc_buf_mode_stream);
   if (!fp->buf_solid_7) goto err;
-  fp->buf_solid_7_d = fp->pacc.gen_buf(fp->pc, fp->tex_solid, pacc_buf_mode_stream);
-  if (!fp->buf_solid_7_d) goto err;
   fp->buf_vertical_2 = fp->pacc.gen_buf(fp->pc, fp->tex_vertical, pacc_buf_mode_stream);
   if (!fp->buf_vertical_2) goto err;
   fp->buf_vertical_3 = fp->pacc.gen_buf(fp->pc, fp->tex_vertical, pacc_buf_mode_stream);
@@ -1110,6 +1101,7 @@ struct fmdsp_pacc *fmdsp_pacc_alloc(void) {
   struct fmdsp_pacc *fp = malloc(sizeof(*fp));
   if (!fp) goto err;
   *fp = (struct fmdsp_pacc) {0};
+  fp->spectrum_track = -1;
 
   memcpy(fp->target_palette, s_palettes[0], sizeof(fp->target_palette));
   return fp;
@@ -1501,7 +1493,7 @@ static void init_default(struct fmdsp_pacc *fp) {
 static void update_default(struct fmdsp_pacc *fp) {
   {
     // passed time
-    uint64_t frames = fp->opna->generated_frames;
+    uint64_t frames = fp->snap->generated_frames;
     int ssec = (int)(frames % 55467) * 100 / 55467;
     uint64_t sec = frames / 55467;
     uint64_t min = sec / 60;
@@ -1539,7 +1531,7 @@ static void update_default(struct fmdsp_pacc *fp) {
   }
   {
     // clock count
-    uint64_t clock = fp->work->timerb_cnt;
+    uint64_t clock = fp->snap->timerb_cnt;
     for (int i = 0; i < 8; i++) {
       int num = clock % 10;
       clock /= 10;
@@ -1550,7 +1542,7 @@ static void update_default(struct fmdsp_pacc *fp) {
   }
   {
     // timerb
-    uint8_t timerb = fp->work->timerb;
+    uint8_t timerb = fp->snap->timerb;
     for (int i = 0; i < 3; i++) {
       int num = timerb % 10;
       timerb /= 10;
@@ -1561,7 +1553,7 @@ static void update_default(struct fmdsp_pacc *fp) {
   }
   {
     // loop count
-    uint8_t loop = fp->work->loop_cnt;
+    uint8_t loop = fp->snap->loop_cnt;
     for (int i = 0; i < 4; i++) {
       int num = loop % 10;
       loop /= 10;
@@ -1593,28 +1585,28 @@ static void update_default(struct fmdsp_pacc *fp) {
     }
   }
   int pos = 0;
-  if (fp->work->loop_timerb_cnt) {
-    pos = fp->work->timerb_cnt_loop * (72+1-4) / fp->work->loop_timerb_cnt;
+  if (fp->snap->loop_timerb_cnt) {
+    pos = fp->snap->timerb_cnt_loop * (72+1-4) / fp->snap->loop_timerb_cnt;
   }
   fp->pacc.buf_rect(
       fp->pc, fp->buf_vertical_3,
       352, 70, 144, 4);
-  if (fp->work->playing) {
+  if (fp->snap->playing) {
     fp->pacc.buf_rect(
         fp->pc, fp->buf_vertical_2,
         352 + pos*2, 70, 8, 4);
   }
   fp->pacc.buf_rect(
-      fp->pc, fp->work->loop_cnt ? fp->buf_solid_7_d : fp->buf_solid_3_d,
+      fp->pc, fp->snap->loop_cnt ? fp->buf_solid_7 : fp->buf_solid_3,
       496, 70, 16, 4);
 
   // circle
   int clock = 8;
-  if (fp->work->playing) {
-    if (fp->work->paused && (fp->framecnt % 32) >= 16) {
+  if (fp->snap->playing) {
+    if (fp->snap->paused && (fp->framecnt % 32) >= 16) {
       clock = 8;
     } else {
-      clock = (fp->work->timerb_cnt / 8) % 8;
+      clock = (fp->snap->timerb_cnt / 8) % 8;
     }
   }
   fp->pacc.buf_rect_off(
@@ -1624,7 +1616,14 @@ static void update_default(struct fmdsp_pacc *fp) {
 
   // fft
   struct fmplayer_fft_disp_data ddata = {0};
-  fft_calc(&ddata, fp->fftin);
+  if (fp->spectrum) {
+    const struct fmplayer_spectrum_disp *disp =
+      fmplayer_spectrum_read(fp->spectrum);
+    ddata = (fp->spectrum_track < 0) ?
+      disp->mix : disp->tracks[fp->spectrum_track];
+  } else if (fp->fftin) {
+    fft_calc(&ddata, fp->fftin);
+  }
   for (int x = 0; x < FFTDISPLEN; x++) {
     fp->pacc.buf_rect(
         fp->pc, fp->buf_horizontal_2_d,
@@ -1668,9 +1667,9 @@ static void update_default(struct fmdsp_pacc *fp) {
     bool playing;
   } levels[FMDSP_LEVEL_COUNT] = {0};
   for (int c = 0; c < 6; c++) {
-    levels[c].level = leveldata_read(&fp->opna->fm.channel[c].leveldata);
+    levels[c].level = fp->snap->level[FMPLAYER_SNAPSHOT_LEVEL_FM+c];
     static const int table[4] = {5, 4, 0, 2};
-    levels[c].pan = table[fp->opna->fm.lselect[c]*2 + fp->opna->fm.rselect[c]];
+    levels[c].pan = table[fp->snap->fm[c].lselect*2 + fp->snap->fm[c].rselect];
   }
   levels[0].t = FMDRIVER_TRACK_FM_1;
   levels[1].t = FMDRIVER_TRACK_FM_2;
@@ -1680,46 +1679,46 @@ static void update_default(struct fmdsp_pacc *fp) {
   levels[5].t = FMDRIVER_TRACK_FM_6;
 
   for (int c = 0; c < 3; c++) {
-    levels[6+c].level = leveldata_read(&fp->opna->resampler.leveldata[c]);
+    levels[6+c].level = fp->snap->level[FMPLAYER_SNAPSHOT_LEVEL_SSG+c];
     levels[6+c].t = FMDRIVER_TRACK_SSG_1+c;
     levels[6+c].pan = 2;
   }
   {
     unsigned dl = 0;
     for (int d = 0; d < 6; d++) {
-      unsigned l = leveldata_read(&fp->opna->drum.drums[d].leveldata);
+      unsigned l = fp->snap->level[FMPLAYER_SNAPSHOT_LEVEL_DRUM+d];
       if (l > dl) dl = l;
     }
     levels[9].level = dl;
     levels[9].pan = 2;
   }
-  levels[10].level = leveldata_read(&fp->opna->adpcm.leveldata);
+  levels[10].level = fp->snap->level[FMPLAYER_SNAPSHOT_LEVEL_ADPCM];
   levels[10].t = FMDRIVER_TRACK_ADPCM;
   {
     static const int table[4] = {5, 4, 0, 2};
     int ind = 0;
-    if (fp->opna->adpcm.control2 & 0x80) ind |= 2;
-    if (fp->opna->adpcm.control2 & 0x40) ind |= 1;
+    if (fp->snap->adpcm.control2 & 0x80) ind |= 2;
+    if (fp->snap->adpcm.control2 & 0x40) ind |= 1;
     levels[10].pan = table[ind];
   }
   for (int p = 0; p < 8; p++) {
     levels[11+p].pan = 5;
     levels[11+p].t = FMDRIVER_TRACK_PPZ8_1+p;
   }
-  if (fp->work->ppz8) {
+  if (fp->snap->ppz8_enabled) {
     for (int p = 0; p < 8; p++) {
-      levels[11+p].level = leveldata_read(&fp->work->ppz8->channel[p].leveldata);
+      levels[11+p].level = fp->snap->level[FMPLAYER_SNAPSHOT_LEVEL_PPZ8+p];
       static const int table[10] = {5, 0, 1, 1, 1, 2, 3, 3, 3, 4};
-      levels[11+p].pan = table[fp->work->ppz8->channel[p].pan];
+      levels[11+p].pan = table[fp->snap->ppz8[p].pan];
     }
   }
   for (int c = 0; c < FMDSP_LEVEL_COUNT; c++) {
     levels[c].masked = c == 9 ? fp->masked_rhythm : fp->masked[levels[c].t];
-    levels[c].prog = fp->work->track_status[levels[c].t].tonenum;
-    levels[c].key = fp->work->track_status[levels[c].t].key;
-    levels[c].playing = fp->work->track_status[levels[c].t].playing;
-    if (fp->work->track_status[levels[c].t].info == FMDRIVER_TRACK_INFO_PDZF ||
-        fp->work->track_status[levels[c].t].info == FMDRIVER_TRACK_INFO_PPZ8) {
+    levels[c].prog = fp->snap->track_status[levels[c].t].tonenum;
+    levels[c].key = fp->snap->track_status[levels[c].t].key;
+    levels[c].playing = fp->snap->track_status[levels[c].t].playing;
+    if (fp->snap->track_status[levels[c].t].info == FMDRIVER_TRACK_INFO_PDZF ||
+        fp->snap->track_status[levels[c].t].info == FMDRIVER_TRACK_INFO_PPZ8) {
       levels[c].playing = false;
     }
     if (!levels[c].playing) levels[c].pan = 5;
@@ -1769,36 +1768,36 @@ static void update_default(struct fmdsp_pacc *fp) {
         0, PANPOT_H*levels[c].pan);
     if (c != 9) {
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_1_d,
+          fp->pc, fp->buf_font_1,
           LEVEL_X + LEVEL_W*c, LEVEL_PROG_Y,
           "%03d", levels[c].prog);
     } else {
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_1_d,
+          fp->pc, fp->buf_font_1,
           LEVEL_X + LEVEL_W*c, LEVEL_PROG_Y,
           "%c%c%c",
-          fp->opna->drum.drums[0].playing ? 'B' : ' ',
-          fp->opna->drum.drums[1].playing ? 'S' : ' ',
-          fp->opna->drum.drums[2].playing ? 'T' : ' ');
+          fp->snap->drum_playing[0] ? 'B' : ' ',
+          fp->snap->drum_playing[1] ? 'S' : ' ',
+          fp->snap->drum_playing[2] ? 'T' : ' ');
     }
     uint8_t oct = levels[c].key >> 4;
     uint8_t n = levels[c].key & 0xf;
     if (c == 9) {
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_1_d,
+          fp->pc, fp->buf_font_1,
           LEVEL_X + LEVEL_W*c, LEVEL_KEY_Y,
           "%c%c%c",
-          fp->opna->drum.drums[3].playing ? 'H' : ' ',
-          fp->opna->drum.drums[4].playing ? 'T' : ' ',
-          fp->opna->drum.drums[5].playing ? 'R' : ' ');
+          fp->snap->drum_playing[3] ? 'H' : ' ',
+          fp->snap->drum_playing[4] ? 'T' : ' ',
+          fp->snap->drum_playing[5] ? 'R' : ' ');
     } else if (levels[c].playing && n < 12) {
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_1_d,
+          fp->pc, fp->buf_font_1,
           LEVEL_X + LEVEL_W*c, LEVEL_KEY_Y,
           "%03d", oct*12 + n);
     } else {
       fp->pacc.buf_printf(
-          fp->pc, fp->buf_font_1_d,
+          fp->pc, fp->buf_font_1,
           LEVEL_X + LEVEL_W*c, LEVEL_KEY_Y,
           "---");
     }
@@ -1916,10 +1915,22 @@ static void mode_update(struct fmdsp_pacc *fp) {
   default:
     break;
   }
+  fp->pacc.buf_keep(fp->buf_font_1);
+  fp->pacc.buf_keep(fp->buf_font_2);
+  fp->pacc.buf_keep(fp->buf_solid_2);
+  fp->pacc.buf_keep(fp->buf_solid_3);
+  fp->pacc.buf_keep(fp->buf_solid_7);
 }
 
 void fmdsp_pacc_render(struct fmdsp_pacc *fp) {
   if (!fp->pc) return;
+  fp->snap = 0;
+  if (fp->snapshots) {
+    fp->snap = fmplayer_snapshots_read(fp->snapshots);
+  } else if (fp->work && fp->opna) {
+    fmplayer_snapshot_take(&fp->own_snap, fp->work, fp->opna);
+    fp->snap = &fp->own_snap;
+  }
   if (fp->comment_tex_buf_changed) {
     void *buf = fp->pacc.tex_lock(fp->tex_comment);
     memcpy(buf, fp->comment_tex_buf, sizeof(fp->comment_tex_buf));
@@ -1952,13 +1963,13 @@ void fmdsp_pacc_render(struct fmdsp_pacc *fp) {
   }
   fp->pacc.buf_clear(fp->buf_key_mask);
   fp->pacc.buf_clear(fp->buf_key_mask_sub);
-  fp->pacc.buf_clear(fp->buf_font_1_d);
-  fp->pacc.buf_clear(fp->buf_font_2_d);
+  fp->pacc.buf_rewind(fp->buf_font_1);
+  fp->pacc.buf_rewind(fp->buf_font_2);
   fp->pacc.buf_clear(fp->buf_num);
   fp->pacc.buf_clear(fp->buf_dt_sign);
-  fp->pacc.buf_clear(fp->buf_solid_2_d);
-  fp->pacc.buf_clear(fp->buf_solid_3_d);
-  fp->pacc.buf_clear(fp->buf_solid_7_d);
+  fp->pacc.buf_rewind(fp->buf_solid_2);
+  fp->pacc.buf_rewind(fp->buf_solid_3);
+  fp->pacc.buf_rewind(fp->buf_solid_7);
   fp->pacc.buf_clear(fp->buf_vertical_2);
   fp->pacc.buf_clear(fp->buf_vertical_3);
   fp->pacc.buf_clear(fp->buf_vertical_7);
@@ -1998,7 +2009,7 @@ void fmdsp_pacc_render(struct fmdsp_pacc *fp) {
   fp->masked[FMDRIVER_TRACK_PPZ8_6] = ppz8mask & (1u<<5);
   fp->masked[FMDRIVER_TRACK_PPZ8_7] = ppz8mask & (1u<<6);
   fp->masked[FMDRIVER_TRACK_PPZ8_8] = ppz8mask & (1u<<7);
-  if (fp->work) {
+  if (fp->snap) {
     switch (fp->lmode) {
     case FMDSP_LEFT_MODE_OPNA:
       update_track_10(fp, track_disp_table_opna, 0);
@@ -2063,21 +2074,17 @@ void fmdsp_pacc_render(struct fmdsp_pacc *fp) {
   fp->pacc.begin_clear(fp->pc);
   fp->pacc.color(fp->pc, 1);
   fp->pacc.draw(fp->pc, fp->buf_font_1, pacc_mode_color);
-  fp->pacc.draw(fp->pc, fp->buf_font_1_d, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_dt_sign, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_checker_1, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_panpot_1_d, pacc_mode_color);
   fp->pacc.color(fp->pc, 3);
   fp->pacc.draw(fp->pc, fp->buf_solid_3, pacc_mode_color);
-  fp->pacc.draw(fp->pc, fp->buf_solid_3_d, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_vertical_3, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_horizontal_3, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_fontm_3, pacc_mode_color);
   fp->pacc.color(fp->pc, 2);
   fp->pacc.draw(fp->pc, fp->buf_font_2, pacc_mode_color);
-  fp->pacc.draw(fp->pc, fp->buf_font_2_d, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_solid_2, pacc_mode_color);
-  fp->pacc.draw(fp->pc, fp->buf_solid_2_d, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_vertical_2, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_horizontal_2_d, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_fontm_2, pacc_mode_color);
@@ -2086,7 +2093,6 @@ void fmdsp_pacc_render(struct fmdsp_pacc *fp) {
   fp->pacc.color(fp->pc, 7);
   fp->pacc.draw(fp->pc, fp->buf_font_7, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_solid_7, pacc_mode_color);
-  fp->pacc.draw(fp->pc, fp->buf_solid_7_d, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_vertical_7, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_tri_7, pacc_mode_color);
   fp->pacc.draw(fp->pc, fp->buf_horizontal_7_d, pacc_mode_color);
@@ -2113,10 +2119,10 @@ void fmdsp_pacc_render(struct fmdsp_pacc *fp) {
   bool playing = false;
   bool stopped = true;
   bool paused = false;
-  if (fp->work) {
-    playing = fp->work->playing && !fp->work->paused;
-    stopped = !fp->work->playing;
-    paused = fp->work->paused;
+  if (fp->snap) {
+    playing = fp->snap->playing && !fp->snap->paused;
+    stopped = !fp->snap->playing;
+    paused = fp->snap->paused;
   }
   fp->pacc.color(fp->pc, playing ? 2 : 3);
   fp->pacc.draw(fp->pc, fp->buf_play, pacc_mode_color);
@@ -2141,6 +2147,25 @@ void fmdsp_pacc_set(struct fmdsp_pacc *fp, struct fmdriver_work *work, struct op
   fp->fftin = idata;
 }
 
+void fmdsp_pacc_set_spectrum(struct fmdsp_pacc *fp,
+                             struct fmplayer_spectrum *spectrum) {
+  fp->spectrum = spectrum;
+}
+
+void fmdsp_pacc_set_snapshots(struct fmdsp_pacc *fp,
+                              struct fmplayer_snapshots *snapshots) {
+  fp->snapshots = snapshots;
+}
+
+int fmdsp_pacc_spectrum_track(const struct fmdsp_pacc *fp) {
+  return fp->spectrum_track;
+}
+
+void fmdsp_pacc_set_spectrum_track(struct fmdsp_pacc *fp, int track) {
+  if (track >= FMPLAYER_SPECTRUM_TRACKS) track = -1;
+  fp->spectrum_track = track;
+}
+
 void fmdsp_pacc_palette(struct fmdsp_pacc *fp, int p) {
   if (p < 0) return;
   if (p >= PALETTE_NUM) return;
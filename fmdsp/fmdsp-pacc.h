@@ -9,6 +9,8 @@ struct pacc_vtable;
 struct fmdriver_work;
 struct opna;
 struct fmplayer_fft_input_data;
+struct fmplayer_spectrum;
+struct fmplayer_snapshots;
 struct fmdsp_font;
 
 enum {
@@ -46,6 +48,19 @@ void fmdsp_pacc_deinit(struct fmdsp_pacc *fp);
 
 void fmdsp_pacc_set(struct fmdsp_pacc *pacc, struct fmdriver_work *work, struct opna *opna, struct fmplayer_fft_input_data *fftin);
 void fmdsp_pacc_render(struct fmdsp_pacc *fp);
+// takes the spectrum from a worker instead of computing it in render,
+// fftin of fmdsp_pacc_set is not used then
+void fmdsp_pacc_set_spectrum(struct fmdsp_pacc *fp,
+                             struct fmplayer_spectrum *spectrum);
+// draws the driver and chip state from the latest published snapshot
+// instead of reading work and opna of fmdsp_pacc_set while they run,
+// which are then only used for the file info, comments and masks
+void fmdsp_pacc_set_snapshots(struct fmdsp_pacc *fp,
+                              struct fmplayer_snapshots *snapshots);
+// which spectrum of fmplayer_spectrum is shown,
+// -1: mix, 0 - FMPLAYER_SPECTRUM_TRACKS-1: oscilloscope track
+int fmdsp_pacc_spectrum_track(const struct fmdsp_pacc *fp);
+void fmdsp_pacc_set_spectrum_track(struct fmdsp_pacc *fp, int track);
 
 void fmdsp_pacc_palette(struct fmdsp_pacc *fp, int p);
 
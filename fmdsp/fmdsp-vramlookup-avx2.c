@@ -0,0 +1,114 @@
+#include "fmdsp/fmdsp.h"
+#include <immintrin.h>
+
+// vpshufb looks up within each 128bit lane,
+// so both lanes get the whole palette
+static void palette_load(__m256i *p, const uint8_t *palette) {
+  union {
+    __m128i xmm;
+    uint8_t u8[16];
+  } pi[3];
+  for (int i = 0; i < FMDSP_PALETTE_COLORS; i++) {
+    for (int c = 0; c < 3; c++) {
+      pi[c].u8[i] = palette[i*3+c];
+    }
+  }
+  for (int c = 0; c < 3; c++) {
+    p[c] = _mm256_broadcastsi128_si256(_mm_load_si128(&pi[c].xmm));
+  }
+}
+
+// 32 pixels, 8 in each of o[4]
+static inline void lookup32(__m256i *o, const __m256i *p, const uint8_t *vram) {
+  __m256i z = _mm256_setzero_si256();
+  __m256i v = _mm256_loadu_si256((const __m256i *)vram);
+
+  __m256i r = _mm256_shuffle_epi8(p[0], v);
+  __m256i g = _mm256_shuffle_epi8(p[1], v);
+  __m256i b = _mm256_shuffle_epi8(p[2], v);
+
+  // unpacks are per lane:
+  // gb[0]: 0-7, 16-23
+  // gb[1]: 8-15, 24-31
+  __m256i gb[2], zr[2];
+  gb[0] = _mm256_unpacklo_epi8(b, g);
+  gb[1] = _mm256_unpackhi_epi8(b, g);
+  zr[0] = _mm256_unpacklo_epi8(r, z);
+  zr[1] = _mm256_unpackhi_epi8(r, z);
+
+  // 0-3, 16-19 / 4-7, 20-23 / 8-11, 24-27 / 12-15, 28-31
+  __m256i t[4];
+  t[0] = _mm256_unpacklo_epi16(gb[0], zr[0]);
+  t[1] = _mm256_unpackhi_epi16(gb[0], zr[0]);
+  t[2] = _mm256_unpacklo_epi16(gb[1], zr[1]);
+  t[3] = _mm256_unpackhi_epi16(gb[1], zr[1]);
+
+  o[0] = _mm256_permute2x128_si256(t[0], t[1], 0x20);
+  o[1] = _mm256_permute2x128_si256(t[2], t[3], 0x20);
+  o[2] = _mm256_permute2x128_si256(t[0], t[1], 0x31);
+  o[3] = _mm256_permute2x128_si256(t[2], t[3], 0x31);
+}
+
+void fmdsp_vramlookup_avx2(uint8_t *vram32, const uint8_t *vram, const uint8_t *palette, int stride) {
+  __m256i p[3];
+  palette_load(p, palette);
+
+  for (int y = 0; y < PC98_H; y++) {
+    for (int x = 0; x < 20; x++) {
+      __m256i o[4];
+      lookup32(o, p, &vram[y*PC98_W+x*32]);
+      for (int i = 0; i < 4; i++) {
+        _mm256_storeu_si256((__m256i *)&vram32[(x*4+i)*32], o[i]);
+      }
+    }
+    vram32 += stride;
+  }
+}
+
+// scale is a constant after inlining so the stores are unrolled
+static inline __attribute__((always_inline)) void scaled(
+    uint8_t *vram32, const uint8_t *vram, const __m256i *p,
+    int stride, const int scale) {
+  __m256i idx[3];
+  if (scale == 2) {
+    idx[0] = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    idx[1] = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+  } else {
+    idx[0] = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+    idx[1] = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+    idx[2] = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+  }
+  for (int y = 0; y < PC98_H; y++) {
+    for (int x = 0; x < 20; x++) {
+      __m256i o[4];
+      lookup32(o, p, &vram[y*PC98_W+x*32]);
+      uint8_t *dst = vram32 + x*32*scale*4;
+      for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < scale; j++) {
+          __m256i w = _mm256_permutevar8x32_epi32(o[i], idx[j]);
+          for (int s = 0; s < scale; s++) {
+            _mm256_storeu_si256((__m256i *)(dst + s*stride), w);
+          }
+          dst += 32;
+        }
+      }
+    }
+    vram32 += stride*scale;
+  }
+}
+
+void fmdsp_vramlookup_scaled_avx2(uint8_t *vram32, const uint8_t *vram, const uint8_t *palette, int stride, int scale) {
+  __m256i p[3];
+  palette_load(p, palette);
+  switch (scale) {
+  case 2:
+    scaled(vram32, vram, p, stride, 2);
+    break;
+  case 3:
+    scaled(vram32, vram, p, stride, 3);
+    break;
+  default:
+    fmdsp_vramlookup_scaled_c(vram32, vram, palette, stride, scale);
+    break;
+  }
+}
@@ -1,13 +1,18 @@
 #include "fmdsp/fmdsp.h"
+#include <string.h>
 
-void fmdsp_vramlookup_c(uint8_t *vram32, const uint8_t *vram, const uint8_t *palette, int stride) {
-  uint32_t palette32[FMDSP_PALETTE_COLORS];
+static void palette32_init(uint32_t *palette32, const uint8_t *palette) {
   for (int i = 0; i < FMDSP_PALETTE_COLORS; i++) {
     uint8_t r = palette[i*3+0];
     uint8_t g = palette[i*3+1];
     uint8_t b = palette[i*3+2];
     palette32[i] = (((uint32_t)r)<<16) | (((uint32_t)g)<<8) | ((uint32_t)b);
   }
+}
+
+void fmdsp_vramlookup_c(uint8_t *vram32, const uint8_t *vram, const uint8_t *palette, int stride) {
+  uint32_t palette32[FMDSP_PALETTE_COLORS];
+  palette32_init(palette32, palette);
   for (int y = 0; y < PC98_H; y++) {
     for (int x = 0; x < PC98_W; x++) {
       uint32_t *row = (uint32_t *)(vram32 + y*stride);
@@ -15,3 +20,18 @@ void fmdsp_vramlookup_c(uint8_t *vram32, const uint8_t *vram, const uint8_t *pal
     }
   }
 }
+
+void fmdsp_vramlookup_scaled_c(uint8_t *vram32, const uint8_t *vram, const uint8_t *palette, int stride, int scale) {
+  uint32_t palette32[FMDSP_PALETTE_COLORS];
+  palette32_init(palette32, palette);
+  for (int y = 0; y < PC98_H; y++) {
+    uint32_t *row = (uint32_t *)(vram32 + y*scale*stride);
+    for (int x = 0; x < PC98_W; x++) {
+      uint32_t c = palette32[vram[y*PC98_W+x]];
+      for (int s = 0; s < scale; s++) row[x*scale+s] = c;
+    }
+    for (int s = 1; s < scale; s++) {
+      memcpy(vram32 + (y*scale+s)*stride, row, PC98_W*scale*4);
+    }
+  }
+}
@@ -10,6 +10,7 @@
 #include <string.h>
 
 fmdsp_vramlookup_type fmdsp_vramlookup_func = fmdsp_vramlookup_c;
+fmdsp_vramlookup_scaled_type fmdsp_vramlookup_scaled_func = fmdsp_vramlookup_scaled_c;
 
 static void vramblit(uint8_t *vram, int x, int y,
                      const uint8_t *data, int w, int h) {
@@ -1208,6 +1209,14 @@ void fmdsp_vrampalette(struct fmdsp *fmdsp, const uint8_t *vram, uint8_t *vram32
   fmdsp_vramlookup_func(vram32, vram, fmdsp->palette, stride);
 }
 
+void fmdsp_vrampalette_scaled(struct fmdsp *fmdsp, const uint8_t *vram, uint8_t *vram32, int stride, int scale) {
+  if (scale == 1) {
+    fmdsp_vramlookup_func(vram32, vram, fmdsp->palette, stride);
+  } else {
+    fmdsp_vramlookup_scaled_func(vram32, vram, fmdsp->palette, stride, scale);
+  }
+}
+
 void fmdsp_dispstyle_set(struct fmdsp *fmdsp, enum FMDSP_DISPSTYLE style) {
   if (style < 0) return;
   if (style >= FMDSP_DISPSTYLE_CNT) return;
@@ -65,6 +65,8 @@ void fmdsp_update(struct fmdsp *fmdsp, struct fmdriver_work *work,
                   struct fmplayer_fft_input_data *idata
                  );
 void fmdsp_vrampalette(struct fmdsp *fmdsp, const uint8_t *vram, uint8_t *vram32, int stride);
+// writes PC98_W*scale x PC98_H*scale pixels to vram32
+void fmdsp_vrampalette_scaled(struct fmdsp *fmdsp, const uint8_t *vram, uint8_t *vram32, int stride, int scale);
 void fmdsp_font_from_fontrom(uint8_t *font, const uint8_t *fontrom);
 void fmdsp_palette_set(struct fmdsp *fmdsp, int p);
 void fmdsp_dispstyle_set(struct fmdsp *fmdsp, enum FMDSP_DISPSTYLE style);
@@ -73,6 +75,7 @@ typedef void (*fmdsp_vramlookup_type)(uint8_t *vram32,
                                       const uint8_t *vram,
                                       const uint8_t *palette,
                                       int stride);
+// shared by all instances, only set at startup before rendering
 extern fmdsp_vramlookup_type fmdsp_vramlookup_func;
 void fmdsp_vramlookup_c(uint8_t *vram32,
                         const uint8_t *vram,
@@ -81,6 +84,22 @@ void fmdsp_vramlookup_c(uint8_t *vram32,
 
 void fmdsp_vramlookup_neon(uint8_t *, const uint8_t *, const uint8_t *, int);
 void fmdsp_vramlookup_ssse3(uint8_t *, const uint8_t *, const uint8_t *, int) __attribute__((hot,optimize(3)));
+void fmdsp_vramlookup_avx2(uint8_t *, const uint8_t *, const uint8_t *, int) __attribute__((hot,optimize(3)));
+
+// lookup and integer upscale in one pass, for scale >= 2
+// the simd versions do 2 and 3 themselves and call the c version otherwise
+typedef void (*fmdsp_vramlookup_scaled_type)(uint8_t *vram32,
+                                             const uint8_t *vram,
+                                             const uint8_t *palette,
+                                             int stride, int scale);
+// shared by all instances, only set at startup before rendering
+extern fmdsp_vramlookup_scaled_type fmdsp_vramlookup_scaled_func;
+void fmdsp_vramlookup_scaled_c(uint8_t *vram32,
+                               const uint8_t *vram,
+                               const uint8_t *palette,
+                               int stride, int scale) __attribute__((hot,optimize(3)));
+void fmdsp_vramlookup_scaled_ssse3(uint8_t *, const uint8_t *, const uint8_t *, int, int) __attribute__((hot,optimize(3)));
+void fmdsp_vramlookup_scaled_avx2(uint8_t *, const uint8_t *, const uint8_t *, int, int) __attribute__((hot,optimize(3)));
 #ifdef __cplusplus
 }
 #endif
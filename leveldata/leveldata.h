@@ -7,30 +7,30 @@
 #include <stdatomic.h>
 #endif
 
+// peak level between reads
+// updated from the synthesis thread and read from the display thread,
+// neither side waits for the other
 struct leveldata {
-  atomic_flag flag;
-  unsigned level;
-  bool read;
+  // peak since the last read
+  atomic_uint level;
 };
 
+// takes the peak, the next one starts from 0
 static inline unsigned leveldata_read(struct leveldata *data) {
-  while (atomic_flag_test_and_set_explicit(&data->flag, memory_order_acquire));
-  unsigned level = data->level;
-  data->read = true;
-  atomic_flag_clear_explicit(&data->flag, memory_order_release);
-  return level;
+  return atomic_exchange_explicit(&data->level, 0, memory_order_relaxed);
 }
 
 static inline void leveldata_update(struct leveldata *data, unsigned level) {
-  while (atomic_flag_test_and_set_explicit(&data->flag, memory_order_acquire));
-  if (data->read || (level > data->level)) data->level = level;
-  data->read = false;
-  atomic_flag_clear_explicit(&data->flag, memory_order_release);
+  unsigned peak = atomic_load_explicit(&data->level, memory_order_relaxed);
+  // fails with peak reloaded when the reader took it in between
+  while (level > peak &&
+         !atomic_compare_exchange_weak_explicit(
+           &data->level, &peak, level,
+           memory_order_relaxed, memory_order_relaxed));
 }
 
 static inline void leveldata_init(struct leveldata *data) {
-  *data = (struct leveldata) {0};
-  atomic_flag_clear_explicit(&data->flag, memory_order_relaxed);
+  atomic_init(&data->level, 0);
 }
 
 #endif // MYON_LEVELDATA_H_INCLUDED
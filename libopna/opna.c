@@ -4,6 +4,73 @@
 #endif
 #include <string.h>
 
+enum {
+  REG_NONE,
+  REG_SSG,
+  REG_DRUM,
+  REG_FM,
+  REG_ADPCM,
+  // writing the same value again has no effect
+  REG_COALESCE = 0x80,
+};
+
+#define N_ REG_NONE
+#define S_ REG_SSG
+#define SC (REG_SSG|REG_COALESCE)
+#define R_ REG_DRUM
+#define RC (REG_DRUM|REG_COALESCE)
+#define F_ REG_FM
+#define FC (REG_FM|REG_COALESCE)
+#define A_ REG_ADPCM
+#define AC (REG_ADPCM|REG_COALESCE)
+// FM rate registers recalculate the current envelope rate
+// with the current key scale, fnum writes apply the latched block
+// the block/fnum2 registers all write one shared latch,
+// so they are never coalesced
+static const uint8_t opna_reg_unit[0x200] = {
+  SC, SC, SC, SC, SC, SC, SC, SC, SC, SC, SC, SC, SC, S_, SC, SC, // 000
+  R_, RC, N_, N_, N_, N_, N_, N_, RC, RC, RC, RC, RC, RC, N_, N_, // 010
+  N_, N_, N_, N_, N_, N_, N_, FC, F_, N_, N_, N_, N_, N_, N_, N_, // 020
+  FC, FC, FC, N_, FC, FC, FC, N_, FC, FC, FC, N_, FC, FC, FC, N_, // 030
+  FC, FC, FC, N_, FC, FC, FC, N_, FC, FC, FC, N_, FC, FC, FC, N_, // 040
+  F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, // 050
+  F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, // 060
+  F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, // 070
+  F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, // 080
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 090
+  F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, // 0a0
+  FC, FC, FC, N_, FC, FC, FC, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 0b0
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 0c0
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 0d0
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 0e0
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 0f0
+  A_, AC, AC, AC, AC, AC, N_, N_, A_, AC, AC, AC, AC, AC, N_, N_, // 100
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 110
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 120
+  FC, FC, FC, N_, FC, FC, FC, N_, FC, FC, FC, N_, FC, FC, FC, N_, // 130
+  FC, FC, FC, N_, FC, FC, FC, N_, FC, FC, FC, N_, FC, FC, FC, N_, // 140
+  F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, // 150
+  F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, // 160
+  F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, // 170
+  F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, // 180
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 190
+  F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, F_, F_, F_, N_, // 1a0
+  FC, FC, FC, N_, FC, FC, FC, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 1b0
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 1c0
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 1d0
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 1e0
+  N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, N_, // 1f0
+};
+#undef N_
+#undef S_
+#undef SC
+#undef R_
+#undef RC
+#undef F_
+#undef FC
+#undef A_
+#undef AC
+
 void opna_reset(struct opna *opna) {
   opna_fm_reset(&opna->fm);
   opna_ssg_reset(&opna->ssg);
@@ -12,14 +79,29 @@ void opna_reset(struct opna *opna) {
   opna_adpcm_reset(&opna->adpcm);
   opna->mask = 0;
   opna->generated_frames = 0;
+  for (int r = 0; r < 0x200; r++) opna->regs[r] = 0x100;
 }
 
 void opna_writereg(struct opna *opna, unsigned reg, unsigned val) {
   val &= 0xff;
-  opna_fm_writereg(&opna->fm, reg, val);
-  opna_ssg_writereg(&opna->ssg, reg, val);
-  opna_drum_writereg(&opna->drum, reg, val);
-  opna_adpcm_writereg(&opna->adpcm, reg, val);
+  if (reg > 0x1ffu) return;
+  unsigned unit = opna_reg_unit[reg];
+  if ((unit & REG_COALESCE) && opna->regs[reg] == val) return;
+  opna->regs[reg] = val;
+  switch (unit & ~REG_COALESCE) {
+  case REG_SSG:
+    opna_ssg_writereg(&opna->ssg, reg, val);
+    break;
+  case REG_DRUM:
+    opna_drum_writereg(&opna->drum, reg, val);
+    break;
+  case REG_FM:
+    opna_fm_writereg(&opna->fm, reg, val);
+    break;
+  case REG_ADPCM:
+    opna_adpcm_writereg(&opna->adpcm, reg, val);
+    break;
+  }
 }
 
 unsigned opna_readreg(const struct opna *opna, unsigned reg) {
@@ -33,14 +115,8 @@ void opna_mix(struct opna *opna, int16_t *buf, unsigned samples) {
 
 void opna_mix_oscillo(struct opna *opna, int16_t *buf, unsigned samples, struct oscillodata *oscillo) {
 #ifdef LIBOPNA_ENABLE_OSCILLO
-  if (oscillo) {
-    for (int i = 0; i < LIBOPNA_OSCILLO_TRACK_COUNT; i++) {
-      memmove(&oscillo[i].buf[0],
-              &oscillo[i].buf[samples],
-              (OSCILLO_SAMPLE_COUNT - samples)*sizeof(oscillo[i].buf[0]));
-    }
-  }
-  unsigned offset = OSCILLO_SAMPLE_COUNT - samples;
+  // all tracks share the write position
+  unsigned offset = oscillo ? oscillo[0].head : 0;
   struct oscillodata *oscillofm = oscillo ? &oscillo[0] : 0;
   struct oscillodata *oscillossg = oscillo ? &oscillo[6] : 0;
 #else
@@ -54,6 +130,21 @@ void opna_mix_oscillo(struct opna *opna, int16_t *buf, unsigned samples, struct
   opna_drum_mix(&opna->drum, buf, samples);
   opna_adpcm_mix(&opna->adpcm, buf, samples);
   opna->generated_frames += samples;
+#ifdef LIBOPNA_ENABLE_OSCILLO
+  if (oscillo) {
+    for (int i = 0; i < LIBOPNA_OSCILLO_TRACK_COUNT; i++) {
+      oscillo[i].head = (offset + samples) & (OSCILLO_SAMPLE_COUNT-1);
+    }
+  }
+#endif
+}
+
+void opna_skip(struct opna *opna, unsigned samples) {
+  opna_fm_skip(&opna->fm, samples);
+  opna_ssg_skip_55466(&opna->ssg, &opna->resampler, samples);
+  opna_drum_skip(&opna->drum, samples);
+  opna_adpcm_skip(&opna->adpcm, samples);
+  opna->generated_frames += samples;
 }
 
 unsigned opna_get_mask(const struct opna *opna) {
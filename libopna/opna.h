@@ -42,6 +42,8 @@ struct opna {
   struct opna_ssg_resampler resampler;
   unsigned mask;
   uint64_t generated_frames;
+  // last written register values for coalescing, 0x100: none
+  uint16_t regs[0x200];
 };
 
 void opna_reset(struct opna *opna);
@@ -50,6 +52,10 @@ unsigned opna_readreg(const struct opna *opna, unsigned reg);
 void opna_mix(struct opna *opna, int16_t *buf, unsigned samples);
 struct oscillodata;
 void opna_mix_oscillo(struct opna *opna, int16_t *buf, unsigned samples, struct oscillodata *oscillo);
+// advance the chip state by samples without synthesis
+// used for fast-forwarding, output resumes with the correct notes
+// but filter and feedback history is not kept
+void opna_skip(struct opna *opna, unsigned samples);
 unsigned opna_get_mask(const struct opna *opna);
 void opna_set_mask(struct opna *opna, unsigned mask);
 
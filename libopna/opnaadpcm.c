@@ -1,4 +1,10 @@
 #include "opnaadpcm.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
 
 enum {
   C1_START = 0x80,
@@ -31,6 +37,7 @@ void opna_adpcm_reset(struct opna_adpcm *adpcm) {
   adpcm->ramptr = 0;
   adpcm->step = 0;
   adpcm->ram = 0;
+  adpcm->pram = 0;
   adpcm->acc = 0;
   adpcm->prev_acc = 0;
   adpcm->adpcmd = 127;
@@ -40,6 +47,60 @@ void opna_adpcm_reset(struct opna_adpcm *adpcm) {
 #endif
 }
 
+// every page of a new ram, never written
+static struct opna_adpcm_ram_page zero_page;
+
+static void page_retain(struct opna_adpcm_ram_page *page) {
+  if (page == &zero_page) return;
+  atomic_fetch_add_explicit(&page->refcnt, 1, memory_order_relaxed);
+}
+
+static void page_release(struct opna_adpcm_ram_page *page) {
+  if (page == &zero_page) return;
+  if (atomic_fetch_sub_explicit(&page->refcnt, 1, memory_order_acq_rel) == 1) {
+    free(page);
+  }
+}
+
+static bool page_shared(struct opna_adpcm_ram_page *page) {
+  return page == &zero_page ||
+    atomic_load_explicit(&page->refcnt, memory_order_acquire) > 1;
+}
+
+static uint8_t ram_read(const struct opna_adpcm *adpcm, uint32_t addr) {
+  addr &= OPNA_ADPCM_RAM_SIZE-1;
+  if (adpcm->ram) return adpcm->ram[addr];
+  return adpcm->pram->pages[addr >> OPNA_ADPCM_RAM_PAGE_BITS]
+    ->data[addr & (OPNA_ADPCM_RAM_PAGE_SIZE-1)];
+}
+
+static void ram_write(struct opna_adpcm *adpcm, uint32_t addr, uint8_t val) {
+  addr &= OPNA_ADPCM_RAM_SIZE-1;
+  if (adpcm->ram) {
+    adpcm->ram[addr] = val;
+    return;
+  }
+  struct opna_adpcm_ram *ram = adpcm->pram;
+  struct opna_adpcm_ram_page *page = ram->pages[addr >> OPNA_ADPCM_RAM_PAGE_BITS];
+  unsigned offset = addr & (OPNA_ADPCM_RAM_PAGE_SIZE-1);
+  // loading the same data again keeps the page shared
+  if (page->data[offset] == val) return;
+  if (page_shared(page)) {
+    struct opna_adpcm_ram_page *newpage = malloc(sizeof(*newpage));
+    if (!newpage) {
+      ram->err = true;
+      return;
+    }
+    atomic_init(&newpage->refcnt, 1);
+    newpage->hash = 0;
+    memcpy(newpage->data, page->data, OPNA_ADPCM_RAM_PAGE_SIZE);
+    page_release(page);
+    ram->pages[addr >> OPNA_ADPCM_RAM_PAGE_BITS] = newpage;
+    page = newpage;
+  }
+  page->data[offset] = val;
+}
+
 static uint32_t addr_conv(const struct opna_adpcm *adpcm, uint16_t a) {
   uint32_t a32 = a;
   return (adpcm->control2 & C2_8BIT) ? (a32<<6) : (a32<<3);
@@ -71,8 +132,8 @@ static void adpcm_calc(struct opna_adpcm *adpcm) {
       }
     }
     uint8_t data = 0;
-    if (adpcm->ram) {
-      data = adpcm->ram[(adpcm->ramptr>>1)&(OPNA_ADPCM_RAM_SIZE-1)];
+    if (adpcm->ram || adpcm->pram) {
+      data = ram_read(adpcm, adpcm->ramptr>>1);
     }
     if (adpcm->ramptr&1) {
       data &= 0x0f;
@@ -152,8 +213,8 @@ void opna_adpcm_writereg(struct opna_adpcm *adpcm, unsigned reg, unsigned val) {
     if ((adpcm->control1 & (C1_START|C1_REC|C1_MEMEXT)) == (C1_REC|C1_MEMEXT)) {
       // external memory write
       if (adpcm->ramptr != addr_conv_e(adpcm, adpcm->end)) {
-        if (adpcm->ram) {
-          adpcm->ram[(adpcm->ramptr>>1)&(OPNA_ADPCM_RAM_SIZE-1)] = val;
+        if (adpcm->ram || adpcm->pram) {
+          ram_write(adpcm, adpcm->ramptr>>1, val);
         }
         adpcm->ramptr += 2;
       } else {
@@ -185,7 +246,7 @@ void opna_adpcm_writereg(struct opna_adpcm *adpcm, unsigned reg, unsigned val) {
 
 void opna_adpcm_mix(struct opna_adpcm *adpcm, int16_t *buf, unsigned samples) {
   unsigned level = 0;
-  if (!adpcm->ram || !(adpcm->control1 & C1_START)) {
+  if ((!adpcm->ram && !adpcm->pram) || !(adpcm->control1 & C1_START)) {
 #ifdef LIBOPNA_ENABLE_LEVELDATA
     leveldata_update(&adpcm->leveldata, level);
 #endif
@@ -217,10 +278,187 @@ void opna_adpcm_mix(struct opna_adpcm *adpcm, int16_t *buf, unsigned samples) {
 #endif
 }
 
+void opna_adpcm_skip(struct opna_adpcm *adpcm, unsigned samples) {
+  if (!adpcm->ram && !adpcm->pram) return;
+  for (unsigned i = 0; i < samples; i++) {
+    if (!(adpcm->control1 & C1_START)) return;
+    adpcm_calc(adpcm);
+  }
+}
+
 void opna_adpcm_set_ram_256k(struct opna_adpcm *adpcm, void *ram) {
   adpcm->ram = ram;
+  adpcm->pram = 0;
 }
 
 void *opna_adpcm_get_ram(struct opna_adpcm *adpcm) {
   return adpcm->ram;
 }
+
+void opna_adpcm_set_ram_paged(struct opna_adpcm *adpcm,
+                              struct opna_adpcm_ram *ram) {
+  adpcm->ram = 0;
+  adpcm->pram = ram;
+}
+
+void opna_adpcm_ram_init(struct opna_adpcm_ram *ram) {
+  for (unsigned p = 0; p < OPNA_ADPCM_RAM_PAGES; p++) {
+    ram->pages[p] = &zero_page;
+  }
+  ram->err = false;
+}
+
+void opna_adpcm_ram_deinit(struct opna_adpcm_ram *ram) {
+  for (unsigned p = 0; p < OPNA_ADPCM_RAM_PAGES; p++) {
+    page_release(ram->pages[p]);
+    ram->pages[p] = &zero_page;
+  }
+}
+
+void opna_adpcm_ram_copy(struct opna_adpcm_ram *dst,
+                         const struct opna_adpcm_ram *src) {
+  for (unsigned p = 0; p < OPNA_ADPCM_RAM_PAGES; p++) {
+    page_retain(src->pages[p]);
+    dst->pages[p] = src->pages[p];
+  }
+  dst->err = src->err;
+}
+
+bool opna_adpcm_ram_pool_init(struct opna_adpcm_ram_pool *pool) {
+  pool->table = 0;
+  pool->cnt = 0;
+  pool->cap = 0;
+#ifdef _WIN32
+  pool->lock = CreateMutexW(0, FALSE, 0);
+  return pool->lock;
+#else
+  return !pthread_mutex_init(&pool->lock, 0);
+#endif
+}
+
+static void pool_lock(struct opna_adpcm_ram_pool *pool) {
+#ifdef _WIN32
+  WaitForSingleObject(pool->lock, INFINITE);
+#else
+  pthread_mutex_lock(&pool->lock);
+#endif
+}
+
+static void pool_unlock(struct opna_adpcm_ram_pool *pool) {
+#ifdef _WIN32
+  ReleaseMutex(pool->lock);
+#else
+  pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+void opna_adpcm_ram_pool_deinit(struct opna_adpcm_ram_pool *pool) {
+  for (size_t i = 0; i < pool->cap; i++) {
+    if (pool->table[i]) page_release(pool->table[i]);
+  }
+  free(pool->table);
+  pool->table = 0;
+  pool->cnt = 0;
+  pool->cap = 0;
+#ifdef _WIN32
+  CloseHandle(pool->lock);
+#else
+  pthread_mutex_destroy(&pool->lock);
+#endif
+}
+
+static uint32_t page_hash(const struct opna_adpcm_ram_page *page) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (unsigned i = 0; i < OPNA_ADPCM_RAM_PAGE_SIZE; i++) {
+    hash ^= page->data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static void pool_insert(struct opna_adpcm_ram_page **table, size_t cap,
+                        struct opna_adpcm_ram_page *page) {
+  size_t i = page->hash & (cap-1);
+  while (table[i]) i = (i+1) & (cap-1);
+  table[i] = page;
+}
+
+// keeps the table at most half full, cap is a power of 2
+static bool pool_resize(struct opna_adpcm_ram_pool *pool, size_t cap) {
+  struct opna_adpcm_ram_page **table = calloc(cap, sizeof(*table));
+  if (!table) return false;
+  for (size_t i = 0; i < pool->cap; i++) {
+    if (pool->table[i]) pool_insert(table, cap, pool->table[i]);
+  }
+  free(pool->table);
+  pool->table = table;
+  pool->cap = cap;
+  return true;
+}
+
+bool opna_adpcm_ram_share(struct opna_adpcm_ram *ram,
+                          struct opna_adpcm_ram_pool *pool) {
+  bool ok = true;
+  pool_lock(pool);
+  for (unsigned p = 0; p < OPNA_ADPCM_RAM_PAGES; p++) {
+    struct opna_adpcm_ram_page *page = ram->pages[p];
+    if (page == &zero_page) continue;
+    uint32_t hash = page_hash(page);
+    struct opna_adpcm_ram_page *found = 0;
+    if (pool->cap) {
+      for (size_t i = hash & (pool->cap-1); pool->table[i];
+           i = (i+1) & (pool->cap-1)) {
+        if (pool->table[i]->hash == hash &&
+            !memcmp(pool->table[i]->data, page->data,
+                    OPNA_ADPCM_RAM_PAGE_SIZE)) {
+          found = pool->table[i];
+          break;
+        }
+      }
+    }
+    if (!found) {
+      if (!memcmp(page->data, zero_page.data, OPNA_ADPCM_RAM_PAGE_SIZE)) {
+        found = &zero_page;
+      } else {
+        if ((pool->cnt+1)*2 > pool->cap &&
+            !pool_resize(pool, pool->cap ? pool->cap*2 : 256)) {
+          ok = false;
+          continue;
+        }
+        page->hash = hash;
+        page_retain(page);
+        pool_insert(pool->table, pool->cap, page);
+        pool->cnt++;
+        continue;
+      }
+    }
+    if (found != page) {
+      page_retain(found);
+      page_release(page);
+      ram->pages[p] = found;
+    }
+  }
+  pool_unlock(pool);
+  return ok;
+}
+
+void opna_adpcm_ram_pool_gc(struct opna_adpcm_ram_pool *pool) {
+  pool_lock(pool);
+  size_t cnt = 0;
+  for (size_t i = 0; i < pool->cap; i++) {
+    struct opna_adpcm_ram_page *page = pool->table[i];
+    if (!page) continue;
+    // only reachable through the pool, which is locked
+    if (atomic_load_explicit(&page->refcnt, memory_order_acquire) == 1) {
+      free(page);
+      pool->table[i] = 0;
+    } else {
+      cnt++;
+    }
+  }
+  pool->cnt = cnt;
+  // entries removed from probe chains are placed again
+  if (pool->cap) pool_resize(pool, pool->cap);
+  pool_unlock(pool);
+}
@@ -3,6 +3,15 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#if defined(_MSC_VER) && !defined(__cplusplus)
+#include "stdatomic.h"
+#else
+#include <stdatomic.h>
+#endif
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 #ifdef LIBOPNA_ENABLE_LEVELDATA
 #include "leveldata/leveldata.h"
 #endif
@@ -11,6 +20,8 @@
 extern "C" {
 #endif
 
+struct opna_adpcm_ram;
+
 struct opna_adpcm {
   uint8_t control1;
   uint8_t control2;
@@ -22,6 +33,7 @@ struct opna_adpcm {
   uint32_t ramptr;
   uint16_t step;
   uint8_t *ram;
+  struct opna_adpcm_ram *pram;
   int16_t acc;
   int16_t prev_acc;
   uint16_t adpcmd;
@@ -34,15 +46,70 @@ struct opna_adpcm {
 
 void opna_adpcm_reset(struct opna_adpcm *adpcm);
 void opna_adpcm_mix(struct opna_adpcm *adpcm, int16_t *buf, unsigned samples);
+// decode without mixing
+void opna_adpcm_skip(struct opna_adpcm *adpcm, unsigned samples);
 void opna_adpcm_writereg(struct opna_adpcm *adpcm, unsigned reg, unsigned val);
 
 enum {
-  OPNA_ADPCM_RAM_SIZE = (1<<18)
+  OPNA_ADPCM_RAM_SIZE = (1<<18),
+  OPNA_ADPCM_RAM_PAGE_BITS = 12,
+  OPNA_ADPCM_RAM_PAGE_SIZE = (1<<OPNA_ADPCM_RAM_PAGE_BITS),
+  OPNA_ADPCM_RAM_PAGES = (OPNA_ADPCM_RAM_SIZE>>OPNA_ADPCM_RAM_PAGE_BITS),
 };
 
 void opna_adpcm_set_ram_256k(struct opna_adpcm *adpcm, void *ram);
 void *opna_adpcm_get_ram(struct opna_adpcm *adpcm);
 
+// copy-on-write adpcm ram made of refcounted pages
+// pages can be shared between instances, and are copied
+// when an instance writes a different value to a shared page
+struct opna_adpcm_ram_page {
+  atomic_uint refcnt;
+  // set while in a pool
+  uint32_t hash;
+  uint8_t data[OPNA_ADPCM_RAM_PAGE_SIZE];
+};
+
+struct opna_adpcm_ram {
+  struct opna_adpcm_ram_page *pages[OPNA_ADPCM_RAM_PAGES];
+  // a page could not be allocated and a write was lost
+  bool err;
+};
+
+// holds one reference to each distinct page shared through it
+struct opna_adpcm_ram_pool {
+  struct opna_adpcm_ram_page **table;
+  size_t cnt;
+  size_t cap;
+  // held while hashing and comparing pages, not used from the audio path
+#ifdef _WIN32
+  // mutex HANDLE, windows.h is only included by opnaadpcm.c
+  void *lock;
+#else
+  pthread_mutex_t lock;
+#endif
+};
+
+// all pages start as a shared zero page, nothing is allocated
+void opna_adpcm_ram_init(struct opna_adpcm_ram *ram);
+void opna_adpcm_ram_deinit(struct opna_adpcm_ram *ram);
+// dst shares all pages of src, dst must not be initialized
+void opna_adpcm_ram_copy(struct opna_adpcm_ram *dst,
+                         const struct opna_adpcm_ram *src);
+// replaces the pages of ram with identical pages in pool
+// and adds the other pages to pool, call after loading the pcm data
+// returns false when out of memory, ram is still valid
+bool opna_adpcm_ram_share(struct opna_adpcm_ram *ram,
+                          struct opna_adpcm_ram_pool *pool);
+// returns false when the lock could not be created
+bool opna_adpcm_ram_pool_init(struct opna_adpcm_ram_pool *pool);
+void opna_adpcm_ram_pool_deinit(struct opna_adpcm_ram_pool *pool);
+// frees pages only referenced by pool
+void opna_adpcm_ram_pool_gc(struct opna_adpcm_ram_pool *pool);
+// ram is used instead of the flat 256k ram
+void opna_adpcm_set_ram_paged(struct opna_adpcm *adpcm,
+                              struct opna_adpcm_ram *ram);
+
 #ifdef __cplusplus
 }
 #endif
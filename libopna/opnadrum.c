@@ -31,8 +31,8 @@ void opna_drum_reset(struct opna_drum *drum) {
   drum->mask = 0;
 }
 
-void opna_drum_set_rom(struct opna_drum *drum, void *romptr) {
-  uint8_t *rom = (uint8_t *)romptr;
+void opna_drum_rom_decode(struct opna_drum_rom *drumrom, const void *romptr) {
+  const uint8_t *rom = (const uint8_t *)romptr;
   static const struct {
     unsigned start;
     unsigned end;
@@ -45,28 +45,24 @@ void opna_drum_set_rom(struct opna_drum *drum, void *romptr) {
     {OPNA_ROM_TOM_START, OPNA_ROM_RIM_START-1, 6},
     {OPNA_ROM_RIM_START, OPNA_ROM_SIZE-1,      6},
   };
-  drum->drums[0].data = drum->rom_bd;
-  drum->drums[1].data = drum->rom_sd;
-  drum->drums[2].data = drum->rom_top;
-  drum->drums[3].data = drum->rom_hh;
-  drum->drums[4].data = drum->rom_tom;
-  drum->drums[5].data = drum->rom_rim;
+  int16_t *data[6] = {
+    drumrom->bd, drumrom->sd, drumrom->top,
+    drumrom->hh, drumrom->tom, drumrom->rim,
+  };
   for (int p = 0; p < 6; p++) {
-    drum->drums[p].playing = false;
-    drum->drums[p].index = 0;
     unsigned addr = part[p].start << 1;
     int step = 0;
     unsigned acc = 0;
     int outindex = 0;
     for (;;) {
       if ((addr>>1) == part[p].end) break;
-      unsigned data = rom[addr>>1];
-      if (!(addr&1)) data >>= 4;
-      data &= ((1<<4)-1);
-      int acc_diff = ((((data&7)<<1)|1) * steps[step]) >> 3;
-      if (data&8) acc_diff = -acc_diff;
+      unsigned d = rom[addr>>1];
+      if (!(addr&1)) d >>= 4;
+      d &= ((1<<4)-1);
+      int acc_diff = ((((d&7)<<1)|1) * steps[step]) >> 3;
+      if (d&8) acc_diff = -acc_diff;
       acc += acc_diff;
-      step += step_inc[data&7];
+      step += step_inc[d&7];
       if (step < 0) step = 0;
       if (step > 48) step = 48;
       addr++;
@@ -75,11 +71,25 @@ void opna_drum_set_rom(struct opna_drum *drum, void *romptr) {
       if (out >= (1<<11)) out -= (1<<12);
       int16_t out16 = out << 4;
       for (int i = 0; i < part[p].div; i++) {
-        drum->drums[p].data[outindex] = out16;
+        data[p][outindex] = out16;
         outindex++;
       }
     }
-    drum->drums[p].len = outindex;
+    drumrom->len[p] = outindex;
+  }
+}
+
+void opna_drum_set_rom(struct opna_drum *drum,
+                       const struct opna_drum_rom *drumrom) {
+  const int16_t *data[6] = {
+    drumrom->bd, drumrom->sd, drumrom->top,
+    drumrom->hh, drumrom->tom, drumrom->rim,
+  };
+  for (int p = 0; p < 6; p++) {
+    drum->drums[p].data = data[p];
+    drum->drums[p].len = drumrom->len[p];
+    drum->drums[p].playing = false;
+    drum->drums[p].index = 0;
   }
 }
 
@@ -123,6 +133,19 @@ void opna_drum_mix(struct opna_drum *drum, int16_t *buf, int samples) {
 #endif
 }
 
+void opna_drum_skip(struct opna_drum *drum, unsigned samples) {
+  for (int d = 0; d < 6; d++) {
+    if (drum->drums[d].playing && drum->drums[d].data) {
+      if (samples >= drum->drums[d].len - drum->drums[d].index) {
+        drum->drums[d].index = 0;
+        drum->drums[d].playing = false;
+      } else {
+        drum->drums[d].index += samples;
+      }
+    }
+  }
+}
+
 void opna_drum_writereg(struct opna_drum *drum, unsigned reg, unsigned val) {
   val &= 0xff;
   switch (reg) {
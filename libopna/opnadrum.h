@@ -26,9 +26,21 @@ extern "C" {
 #define OPNA_ROM_TOM_SIZE   ((OPNA_ROM_RIM_START-OPNA_ROM_TOM_START)*2*6)
 #define OPNA_ROM_RIM_SIZE   ((OPNA_ROM_SIZE-OPNA_ROM_RIM_START)*2*6)
 
+// decoded rhythm samples, read-only after opna_drum_rom_decode
+// one can be shared by any number of struct opna_drum
+struct opna_drum_rom {
+  int16_t bd[OPNA_ROM_BD_SIZE];
+  int16_t sd[OPNA_ROM_SD_SIZE];
+  int16_t top[OPNA_ROM_TOP_SIZE];
+  int16_t hh[OPNA_ROM_HH_SIZE];
+  int16_t tom[OPNA_ROM_TOM_SIZE];
+  int16_t rim[OPNA_ROM_RIM_SIZE];
+  unsigned len[6];
+};
+
 struct opna_drum {
   struct {
-    int16_t *data;
+    const int16_t *data;
     bool playing;
     unsigned index;
     unsigned len;
@@ -40,20 +52,18 @@ struct opna_drum {
 #endif
   } drums[6];
   unsigned total_level;
-  int16_t rom_bd[OPNA_ROM_BD_SIZE];
-  int16_t rom_sd[OPNA_ROM_SD_SIZE];
-  int16_t rom_top[OPNA_ROM_TOP_SIZE];
-  int16_t rom_hh[OPNA_ROM_HH_SIZE];
-  int16_t rom_tom[OPNA_ROM_TOM_SIZE];
-  int16_t rom_rim[OPNA_ROM_RIM_SIZE];
   unsigned mask;
 };
 
 void opna_drum_reset(struct opna_drum *drum);
-// set rom data, size: 0x2000 (8192) bytes
-void opna_drum_set_rom(struct opna_drum *drum, void *rom);
+// decode rom data, size: 0x2000 (8192) bytes
+void opna_drum_rom_decode(struct opna_drum_rom *drumrom, const void *rom);
+// drumrom is referenced, not copied, until the next opna_drum_reset
+void opna_drum_set_rom(struct opna_drum *drum,
+                       const struct opna_drum_rom *drumrom);
 
 void opna_drum_mix(struct opna_drum *drum, int16_t *buf, int samples);
+void opna_drum_skip(struct opna_drum *drum, unsigned samples);
 
 void opna_drum_writereg(struct opna_drum *drum, unsigned reg, unsigned val);
 
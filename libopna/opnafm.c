@@ -117,7 +117,7 @@ static unsigned blkfnum2keycode(unsigned blk, unsigned fnum) {
 
 #undef F
 
-static void opna_fm_slot_phase(struct opna_fm_slot *slot, unsigned freq) {
+static unsigned opna_fm_slot_phase_inc(const struct opna_fm_slot *slot, unsigned freq) {
 // TODO: detune
 //  freq += slot->dt;
   unsigned det = dettable[slot->det & 0x3][slot->keycode];
@@ -126,7 +126,11 @@ static void opna_fm_slot_phase(struct opna_fm_slot *slot, unsigned freq) {
   freq &= (1U<<17)-1;
   int mul = slot->mul << 1;
   if (!mul) mul = 1;
-  slot->phase += ((freq * mul)>>1);
+  return (freq * mul)>>1;
+}
+
+static void opna_fm_slot_phase(struct opna_fm_slot *slot, unsigned freq) {
+  slot->phase += opna_fm_slot_phase_inc(slot, freq);
 }
 
 void opna_fm_chan_phase(struct opna_fm_channel *chan) {
@@ -681,7 +685,10 @@ void opna_fm_mix(struct opna_fm *fm, int16_t *buf, unsigned samples,
       if (nlevel[1] > nlevel[0]) nlevel[0] = nlevel[1];
       if (nlevel[0] > level[c]) level[c] = nlevel[0];
 #ifdef LIBOPNA_ENABLE_OSCILLO
-      if (oscillo) oscillo[c].buf[offset+i] = o.data[0] + o.data[1];
+      if (oscillo) {
+        oscillo[c].buf[(offset+i) & (OSCILLO_SAMPLE_COUNT-1)] =
+          o.data[0] + o.data[1];
+      }
 #endif
       // TODO: CSM
       if (c == 2 && fm->ch3.mode != CH3_MODE_NORMAL) {
@@ -726,3 +733,51 @@ void opna_fm_mix(struct opna_fm *fm, int16_t *buf, unsigned samples,
   }
 #endif
 }
+
+void opna_fm_skip(struct opna_fm *fm, unsigned samples) {
+  if (!samples) return;
+  // envelope updates happen at sample first, first+3, ...
+  unsigned first = fm->env_div3;
+  unsigned ticks = 0;
+  if (first < samples) {
+    ticks = (samples - 1 - first) / 3 + 1;
+    fm->env_div3 = 2 - (samples - 1 - (first + 3*(ticks-1)));
+  } else {
+    fm->env_div3 -= samples;
+  }
+  for (int c = 0; c < 6; c++) {
+    struct opna_fm_channel *chan = &fm->channel[c];
+    for (int s = 0; s < 4; s++) {
+      struct opna_fm_slot *slot = &chan->slot[s];
+      unsigned freq;
+      if (c == 2 && s != 3 && fm->ch3.mode != CH3_MODE_NORMAL) {
+        freq = blkfnum2freq(fm->ch3.blk[s], fm->ch3.fnum[s]);
+      } else {
+        freq = blkfnum2freq(chan->blk, chan->fnum);
+      }
+      uint32_t inc = opna_fm_slot_phase_inc(slot, freq);
+      unsigned t = 0;
+      if (ticks && slot->keyon_ext) {
+        bool restart = !slot->keyon;
+        opna_fm_slot_key(chan, s, true);
+        opna_fm_slot_env(slot, fm->hires_env);
+        slot->keyon_ext = false;
+        t++;
+        if (restart) {
+          slot->phase = inc * (samples - first);
+        } else {
+          slot->phase += inc * samples;
+        }
+      } else {
+        slot->phase += inc * samples;
+      }
+      for (; t < ticks; t++) {
+        if (slot->env_state == ENV_OFF) {
+          slot->env_count += ticks - t;
+          break;
+        }
+        opna_fm_slot_env(slot, fm->hires_env);
+      }
+    }
+  }
+}
@@ -108,6 +108,8 @@ void opna_fm_reset(struct opna_fm *fm);
 struct oscillodata;
 void opna_fm_mix(struct opna_fm *fm, int16_t *buf, unsigned samples, struct oscillodata *oscillo, unsigned offset);
 void opna_fm_writereg(struct opna_fm *fm, unsigned reg, unsigned val);
+// advance phase and envelope without generating output
+void opna_fm_skip(struct opna_fm *fm, unsigned samples);
 
 //
 void opna_fm_chan_reset(struct opna_fm_channel *chan);
@@ -360,7 +360,9 @@ void opna_ssg_mix_55466(
     }
     for (int ch = 0; ch < 3; ch++) {
 #ifdef LIBOPNA_ENABLE_OSCILLO
-      if (oscillo) oscillo[ch].buf[offset+i] = outbuf[ch] << 1;
+      if (oscillo) {
+        oscillo[ch].buf[(offset+i) & (OSCILLO_SAMPLE_COUNT-1)] = outbuf[ch] << 1;
+      }
 #endif
       int32_t nlevel = outbuf[ch];
       if (nlevel < 0) nlevel = -nlevel;
@@ -386,3 +388,75 @@ void opna_ssg_mix_55466(
 #endif
 }
 #undef BUFINDEX
+
+// counter incremented every sample, reset when counter+1 >= period
+// returns the number of resets in samples
+static uint32_t opna_ssg_counter_skip(uint32_t *counter, uint32_t period, uint32_t samples) {
+  if (!period) period = 1;
+  uint32_t first = ((*counter + 1) >= period) ? 1 : period - *counter;
+  if (samples < first) {
+    *counter += samples;
+    return 0;
+  }
+  samples -= first;
+  *counter = samples % period;
+  return 1 + samples / period;
+}
+
+enum {
+  // noise LFSR: x^17 + x^14 + 1
+  LFSR_PERIOD = (1<<17)-1,
+};
+
+void opna_ssg_skip_raw(struct opna_ssg *ssg, uint32_t samples) {
+  uint32_t counter = ssg->noise_counter;
+  uint32_t noise = opna_ssg_counter_skip(&counter, opna_ssg_noise_period(ssg) << 1, samples);
+  ssg->noise_counter = counter;
+  noise %= LFSR_PERIOD;
+  for (uint32_t i = 0; i < noise; i++) {
+    ssg->lfsr |= (!((ssg->lfsr & 1) ^ ((ssg->lfsr >> 3) & 1))) << 17;
+    ssg->lfsr >>= 1;
+  }
+  if (!ssg->env_holding) {
+    counter = ssg->env_counter;
+    uint32_t env = opna_ssg_counter_skip(&counter, opna_ssg_env_period(ssg), samples);
+    ssg->env_counter = counter;
+    while (env) {
+      uint32_t steps = 0x20 - ssg->env_level;
+      if (env < steps) {
+        ssg->env_level += env;
+        break;
+      }
+      env -= steps;
+      ssg->env_level = 0;
+      if (ssg->env_alt) {
+        ssg->env_att = !ssg->env_att;
+      }
+      if (ssg->env_hld) {
+        ssg->env_level = 0x1f;
+        ssg->env_holding = true;
+        ssg->env_counter = 0;
+        break;
+      }
+      // full cycles only toggle the attack direction
+      if (ssg->env_alt && ((env / 0x20) & 1)) {
+        ssg->env_att = !ssg->env_att;
+      }
+      env %= 0x20;
+    }
+  }
+  for (int ch = 0; ch < 3; ch++) {
+    counter = ssg->ch[ch].tone_counter;
+    uint32_t toggle = opna_ssg_counter_skip(&counter, opna_ssg_tone_period(ssg, ch), samples);
+    ssg->ch[ch].tone_counter = counter;
+    if (toggle & 1) ssg->ch[ch].out = !ssg->ch[ch].out;
+  }
+}
+
+void opna_ssg_skip_55466(
+  struct opna_ssg *ssg, struct opna_ssg_resampler *resampler,
+  int samples) {
+  uint32_t index = resampler->index + 9u*samples;
+  opna_ssg_skip_raw(ssg, (index>>1) - (resampler->index>>1));
+  resampler->index = index & ((1u<<(OPNA_SSG_SINCTABLEBIT+1))-1);
+}
@@ -68,6 +68,11 @@ struct oscillodata;
 void opna_ssg_mix_55466(
   struct opna_ssg *ssg, struct opna_ssg_resampler *resampler,
   int16_t *buf, int samples, struct oscillodata *oscillo, unsigned offset);
+// advance tone, noise and envelope counters without generating output
+void opna_ssg_skip_raw(struct opna_ssg *ssg, uint32_t samples);
+void opna_ssg_skip_55466(
+  struct opna_ssg *ssg, struct opna_ssg_resampler *resampler,
+  int samples);
 void opna_ssg_writereg(struct opna_ssg *ssg, unsigned reg, unsigned val);
 unsigned opna_ssg_readreg(const struct opna_ssg *ssg, unsigned reg);
 // channel level (0 - 31)
@@ -91,6 +96,7 @@ static inline void opna_ssg_set_mix(struct opna_ssg *ssg, uint32_t mix) {
 
 typedef void (*opna_ssg_sinc_calc_func_type)(unsigned resampler_index,
                                              const int16_t *inbuf, int32_t *outbuf);
+// shared by all instances, only set at startup before mixing
 extern opna_ssg_sinc_calc_func_type opna_ssg_sinc_calc_func;
 void opna_ssg_sinc_calc_c(unsigned resampler_index,
                           const int16_t *inbuf, int32_t *outbuf) __attribute__((hot, optimize(3)));
@@ -15,6 +15,7 @@ void opna_timer_reset(struct opna_timer *timer, struct opna *opna) {
   timer->interrupt_userptr = 0;
   timer->mix_cb = 0;
   timer->mix_userptr = 0;
+  timer->skip_cb = 0;
   timer->timerb = 0;
   timer->timerb_load = false;
   timer->timerb_enable = false;
@@ -35,9 +36,13 @@ void opna_timer_set_mix_callback(struct opna_timer *timer, opna_timer_mix_cb_t f
   timer->mix_userptr = userptr;
 }
 
+void opna_timer_set_skip_callback(struct opna_timer *timer, opna_timer_skip_cb_t func) {
+  timer->skip_cb = func;
+}
+
 void opna_timer_writereg(struct opna_timer *timer, unsigned reg, unsigned val) {
   val &= 0xff;
-  opna_writereg(timer->opna, reg, val);
+  if (timer->opna) opna_writereg(timer->opna, reg, val);
   switch (reg) {
   case 0x24:
     timer->timera &= ~0xff;
@@ -71,7 +76,8 @@ void opna_timer_mix(struct opna_timer *timer, int16_t *buf, unsigned samples) {
   opna_timer_mix_oscillo(timer, buf, samples, 0);
 }
 
-void opna_timer_mix_oscillo(struct opna_timer *timer, int16_t *buf, unsigned samples, struct oscillodata *oscillo) {
+// buf == 0: skip
+static void opna_timer_run(struct opna_timer *timer, int16_t *buf, unsigned samples, struct oscillodata *oscillo) {
   do {
     unsigned generate_samples = samples;
     if (timer->timerb_enable && timer->timerb_load) {
@@ -86,11 +92,18 @@ void opna_timer_mix_oscillo(struct opna_timer *timer, int16_t *buf, unsigned sam
         generate_samples = timera_samples;
       }
     }
-    opna_mix_oscillo(timer->opna, buf, generate_samples, oscillo);
-    if (timer->mix_cb) {
-      timer->mix_cb(timer->mix_userptr, buf, generate_samples);
+    if (buf) {
+      opna_mix_oscillo(timer->opna, buf, generate_samples, oscillo);
+      if (timer->mix_cb) {
+        timer->mix_cb(timer->mix_userptr, buf, generate_samples);
+      }
+      buf += generate_samples*2;
+    } else {
+      if (timer->opna) opna_skip(timer->opna, generate_samples);
+      if (timer->skip_cb) {
+        timer->skip_cb(timer->mix_userptr, generate_samples);
+      }
     }
-    buf += generate_samples*2;
     samples -= generate_samples;
     if (timer->timera_load) {
       timer->timera = (timer->timera + generate_samples) & ((1<<TIMERA_BITS)-1);
@@ -113,3 +126,11 @@ void opna_timer_mix_oscillo(struct opna_timer *timer, int16_t *buf, unsigned sam
     }
   } while (samples);
 }
+
+void opna_timer_mix_oscillo(struct opna_timer *timer, int16_t *buf, unsigned samples, struct oscillodata *oscillo) {
+  opna_timer_run(timer, buf, samples, oscillo);
+}
+
+void opna_timer_skip(struct opna_timer *timer, unsigned samples) {
+  opna_timer_run(timer, 0, samples, 0);
+}
@@ -10,6 +10,7 @@ extern "C" {
 
 typedef void (*opna_timer_int_cb_t)(void *ptr);
 typedef void (*opna_timer_mix_cb_t)(void *ptr, int16_t *buf, unsigned samples);
+typedef void (*opna_timer_skip_cb_t)(void *ptr, unsigned samples);
 
 struct opna;
 
@@ -20,6 +21,8 @@ struct opna_timer {
   void *interrupt_userptr;
   opna_timer_mix_cb_t mix_cb;
   void *mix_userptr;
+  // called with mix_userptr
+  opna_timer_skip_cb_t skip_cb;
   uint16_t timera;
   uint8_t timerb;
   bool timera_load;
@@ -35,10 +38,15 @@ void opna_timer_set_int_callback(struct opna_timer *timer,
                                  opna_timer_int_cb_t func, void *userptr);
 void opna_timer_set_mix_callback(struct opna_timer *timer,
                                  opna_timer_mix_cb_t func, void *userptr);
+void opna_timer_set_skip_callback(struct opna_timer *timer,
+                                  opna_timer_skip_cb_t func);
 void opna_timer_writereg(struct opna_timer *timer, unsigned reg, unsigned val);
 void opna_timer_mix(struct opna_timer *timer, int16_t *buf, unsigned samples);
 struct oscillodata;
 void opna_timer_mix_oscillo(struct opna_timer *timer, int16_t *buf, unsigned samples, struct oscillodata *oscillo);
+// run timers and interrupts without synthesis (fast-forward)
+// timers reset with opna == 0 only keep time and can only be skipped
+void opna_timer_skip(struct opna_timer *timer, unsigned samples);
 
 #ifdef __cplusplus
 }
@@ -1,4 +1,5 @@
 #include "s98gen.h"
+#include <stdlib.h>
 
 static uint32_t read32le(const void *dataptr, size_t offset) {
   const uint8_t *data = (const uint8_t *)dataptr;
@@ -41,7 +42,20 @@ bool s98gen_init(struct s98gen *s98, void *s98dataptr, size_t s98data_size) {
   }
   s98->s98data = s98data;
   s98->s98data_size = s98data_size;
-  s98->current_offset = read32le(s98data, 0x14);
+  s98->data_offset = read32le(s98data, 0x14);
+  s98->current_offset = s98->data_offset;
+  s98->loop_offset = read32le(s98data, 0x18);
+  if (s98->loop_offset >= s98data_size) s98->loop_offset = 0;
+  s98->loop_cnt = 0;
+  s98->sample = 0;
+  for (unsigned r = 0; r < 0x200; r++) s98->regs[r] = 0x100;
+  for (unsigned c = 0; c < 6; c++) s98->keyon[c] = 0;
+  s98->index = 0;
+  s98->index_cnt = 0;
+  s98->length = 0;
+  s98->loop_sample = 0;
+  s98->index_end = 0;
+  s98->ram_end = 0;
   s98->opnaclock = clock;
   s98->samples_to_generate = 0;
   s98->samples_to_generate_frac = 0;
@@ -73,25 +87,45 @@ static void s98gen_set_samples_to_generate(struct s98gen *s98, size_t ticks) {
   s98->samples_to_generate_frac = s & ((((size_t)1)<<16)-1);
 }
 
-static bool s98gen_parse_s98(struct s98gen *s98) {
+
+static void s98gen_writereg(struct s98gen *s98, unsigned reg, unsigned val,
+                            bool write) {
+  if (reg == 0x28) {
+    unsigned c = val & 3;
+    if (c != 3) s98->keyon[c + ((val & 4) ? 3 : 0)] = val & 0xf0;
+  } else {
+    s98->regs[reg] = val;
+  }
+  if (write) {
+    opna_writereg(&s98->opna, reg, val);
+  } else if (reg == 0x108) {
+    s98->ram_end = s98->current_offset + 3;
+  }
+}
+
+// write: false when indexing, only the shadow is updated
+static bool s98gen_parse_s98(struct s98gen *s98, bool write) {
+  bool jumped = false;
   for (;;) {
+    if (s98->s98data_size < (s98->current_offset + 1)) return false;
     switch (s98->s98data[s98->current_offset]) {
     case 0x00:
+    case 0x01:
       if (s98->s98data_size < (s98->current_offset + 3)) return false;
-      opna_writereg(&s98->opna,
+      s98gen_writereg(s98,
+        (s98->s98data[s98->current_offset] << 8) |
         s98->s98data[s98->current_offset+1],
-        s98->s98data[s98->current_offset+2]);
+        s98->s98data[s98->current_offset+2], write);
       s98->current_offset += 3;
       break;
-    case 0x01:
-      if (s98->s98data_size < (s98->current_offset + 3)) return false;
-      opna_writereg(&s98->opna,
-        s98->s98data[s98->current_offset+1] | 0x100,
-        s98->s98data[s98->current_offset+2]);
-      s98->current_offset += 3;
+    case 0xfd:
+      // loop without sync
+      if (!s98->loop_offset || jumped) return false;
+      jumped = true;
+      s98->current_offset = s98->loop_offset;
+      s98->loop_cnt++;
       break;
     case 0xfe:
-      if (s98->s98data_size < (s98->current_offset+1)) return false;
       s98->current_offset++;
       {
         size_t vv = s98gen_getvv(s98);
@@ -100,7 +134,6 @@ static bool s98gen_parse_s98(struct s98gen *s98) {
       }
       return true;
     case 0xff:
-      if (s98->s98data_size < (s98->current_offset + 1)) return false;
       s98->current_offset++;
       s98gen_set_samples_to_generate(s98, 1);
       return true;
@@ -110,32 +143,265 @@ static bool s98gen_parse_s98(struct s98gen *s98) {
   }
 }
 
-bool s98gen_generate(struct s98gen *s98, int16_t *buf, size_t samples) {
+// buf == 0: skip
+// returns the number of samples run
+static size_t s98gen_run(struct s98gen *s98, int16_t *buf, size_t samples) {
+  size_t done = 0;
+  while (done < samples) {
+    if (!s98->samples_to_generate) {
+      if (!s98gen_parse_s98(s98, true)) break;
+      continue;
+    }
+    size_t n = samples - done;
+    if (n > s98->samples_to_generate) n = s98->samples_to_generate;
+    if (buf) {
+      opna_mix(&s98->opna, buf, n);
+      buf += n*2;
+    } else {
+      opna_skip(&s98->opna, n);
+    }
+    s98->samples_to_generate -= n;
+    s98->sample += n;
+    done += n;
+  }
+  return done;
+}
+
+size_t s98gen_generate(struct s98gen *s98, int16_t *buf, size_t samples) {
   for (size_t i = 0; i < samples; i++) {
     buf[i*2+0] = 0;
     buf[i*2+1] = 0;
   }
-  if (samples <= s98->samples_to_generate) {
-    opna_mix(&s98->opna, buf, samples);
-    s98->samples_to_generate -= samples;
-  } else {
-    opna_mix(&s98->opna, buf, s98->samples_to_generate);
-    buf += s98->samples_to_generate * 2;
-    samples -= s98->samples_to_generate;
-    s98->samples_to_generate = 0;
-    while (samples) {
-      if (!s98gen_parse_s98(s98)) return false;
-      if (s98->samples_to_generate >= samples) {
-        opna_mix(&s98->opna, buf, samples);
-        s98->samples_to_generate -= samples;
-        samples = 0;
+  return s98gen_run(s98, buf, samples);
+}
+
+size_t s98gen_skip(struct s98gen *s98, size_t samples) {
+  return s98gen_run(s98, 0, samples);
+}
+
+void s98gen_deinit(struct s98gen *s98) {
+  free(s98->index);
+  s98->index = 0;
+  s98->index_cnt = 0;
+}
+
+static void s98gen_save(const struct s98gen *s98,
+                        struct s98gen_checkpoint *cp) {
+  cp->sample = s98->sample;
+  cp->offset = s98->current_offset;
+  cp->samples_to_generate = s98->samples_to_generate;
+  cp->samples_to_generate_frac = s98->samples_to_generate_frac;
+  cp->pass = s98->loop_cnt;
+  for (unsigned c = 0; c < 6; c++) cp->keyon[c] = s98->keyon[c];
+  for (unsigned r = 0; r < 0x200; r++) cp->regs[r] = s98->regs[r];
+}
+
+static void s98gen_load(struct s98gen *s98,
+                        const struct s98gen_checkpoint *cp) {
+  s98->sample = cp->sample;
+  s98->current_offset = cp->offset;
+  s98->samples_to_generate = cp->samples_to_generate;
+  s98->samples_to_generate_frac = cp->samples_to_generate_frac;
+  s98->loop_cnt = cp->pass;
+  for (unsigned c = 0; c < 6; c++) s98->keyon[c] = cp->keyon[c];
+  for (unsigned r = 0; r < 0x200; r++) s98->regs[r] = cp->regs[r];
+}
+
+bool s98gen_build_index(struct s98gen *s98, uint32_t interval) {
+  if (!interval) interval = 1;
+  struct s98gen_checkpoint saved;
+  unsigned saved_loop_cnt = s98->loop_cnt;
+  size_t saved_ram_end = s98->ram_end;
+  s98gen_save(s98, &saved);
+  s98->sample = 0;
+  s98->current_offset = s98->data_offset;
+  s98->samples_to_generate = 0;
+  s98->samples_to_generate_frac = 0;
+  s98->loop_cnt = 0;
+  for (unsigned c = 0; c < 6; c++) s98->keyon[c] = 0;
+  for (unsigned r = 0; r < 0x200; r++) s98->regs[r] = 0x100;
+  s98->ram_end = 0;
+
+  struct s98gen_checkpoint *index = 0;
+  size_t cnt = 0;
+  size_t cap = 0;
+  uint64_t next = 0;
+  uint64_t length = 0;
+  uint64_t loop_sample = 0;
+  uint64_t index_end = 0;
+  bool ok = true;
+  // the state is periodic from the second pass of the loop
+  for (;;) {
+    uint64_t pos = s98->sample;
+    size_t start = s98->current_offset;
+    unsigned loop_cnt = s98->loop_cnt;
+    bool parsed = s98gen_parse_s98(s98, false);
+    if (s98->loop_cnt != loop_cnt) {
+      if (loop_cnt) {
+        index_end = pos;
+        break;
+      }
+      length = pos;
+    } else if (!loop_cnt && start <= s98->loop_offset &&
+               s98->loop_offset < s98->current_offset) {
+      loop_sample = pos;
+    }
+    if (!parsed) {
+      if (s98->current_offset < s98->s98data_size &&
+          s98->s98data[s98->current_offset] == 0xfd) {
+        // end without loop
+        length = pos;
+        index_end = pos;
       } else {
-        opna_mix(&s98->opna, buf, s98->samples_to_generate);
-        buf += s98->samples_to_generate*2;
-        samples -= s98->samples_to_generate;
-        s98->samples_to_generate = 0;
+        ok = false;
+      }
+      break;
+    }
+    if (pos >= next) {
+      if (cnt == cap) {
+        size_t newcap = cap ? cap * 2 : 64;
+        struct s98gen_checkpoint *newindex =
+          realloc(index, newcap * sizeof(*index));
+        if (!newindex) {
+          ok = false;
+          break;
+        }
+        index = newindex;
+        cap = newcap;
       }
+      s98gen_save(s98, &index[cnt++]);
+      index[cnt-1].sample = pos;
+      next = pos + interval;
     }
+    s98->sample += s98->samples_to_generate;
+    s98->samples_to_generate = 0;
   }
+
+  size_t ram_end = s98->ram_end;
+  s98gen_load(s98, &saved);
+  s98->loop_cnt = saved_loop_cnt;
+  if (!ok || !cnt) {
+    free(index);
+    s98->ram_end = saved_ram_end;
+    return false;
+  }
+  free(s98->index);
+  s98->index = index;
+  s98->index_cnt = cnt;
+  s98->length = length;
+  s98->loop_sample = loop_sample;
+  s98->index_end = index_end;
+  s98->ram_end = ram_end;
   return true;
 }
+
+// writes the adpcm registers from the data between from and to
+// so the adpcm ram has its contents at to
+static void s98gen_replay_ram(struct s98gen *s98, size_t from, size_t to) {
+  size_t offset = from;
+  while (offset < to && offset < s98->s98data_size) {
+    switch (s98->s98data[offset]) {
+    case 0x00:
+      offset += 3;
+      break;
+    case 0x01:
+      if (s98->s98data_size < (offset + 3)) return;
+      if (s98->s98data[offset+1] < 0x10) {
+        opna_writereg(&s98->opna, 0x100 | s98->s98data[offset+1],
+                      s98->s98data[offset+2]);
+      }
+      offset += 3;
+      break;
+    case 0xfe:
+      offset++;
+      while (offset < s98->s98data_size && (s98->s98data[offset++] & 0x80));
+      break;
+    case 0xff:
+      offset++;
+      break;
+    default:
+      return;
+    }
+  }
+}
+
+static void s98gen_restore_reg(struct s98gen *s98, unsigned reg) {
+  if (s98->regs[reg] < 0x100) opna_writereg(&s98->opna, reg, s98->regs[reg]);
+}
+
+static void s98gen_restore_regs(struct s98gen *s98) {
+  s98gen_restore_reg(s98, 0x22);
+  s98gen_restore_reg(s98, 0x27);
+  s98gen_restore_reg(s98, 0x29);
+  for (unsigned r = 0x00; r < 0x10; r++) s98gen_restore_reg(s98, r);
+  s98gen_restore_reg(s98, 0x11);
+  for (unsigned r = 0x18; r < 0x1e; r++) s98gen_restore_reg(s98, r);
+  for (unsigned p = 0; p < 0x200; p += 0x100) {
+    for (unsigned r = 0x30; r < 0xa0; r++) s98gen_restore_reg(s98, p|r);
+    // block/fnum2 goes to one latch shared by all channels until
+    // fnum1 is written, so each is restored right before its fnum1
+    // (the latch registers are never coalesced by opna_writereg)
+    for (unsigned c = 0; c < 3; c++) {
+      s98gen_restore_reg(s98, p|(0xa4+c));
+      s98gen_restore_reg(s98, p|(0xa0+c));
+      s98gen_restore_reg(s98, p|(0xac+c));
+      s98gen_restore_reg(s98, p|(0xa8+c));
+    }
+    for (unsigned r = 0xb0; r < 0xb7; r++) s98gen_restore_reg(s98, p|r);
+  }
+  for (unsigned r = 0x101; r < 0x10e; r++) {
+    if (r != 0x108) s98gen_restore_reg(s98, r);
+  }
+  for (unsigned c = 0; c < 6; c++) {
+    if (s98->keyon[c]) {
+      opna_writereg(&s98->opna, 0x28, s98->keyon[c] | (c % 3) | ((c / 3) << 2));
+    }
+  }
+}
+
+bool s98gen_seek(struct s98gen *s98, uint64_t sample) {
+  if (!s98->index_cnt) return false;
+  uint64_t target = sample;
+  uint64_t loops = 0;
+  uint64_t period = s98->index_end - s98->length;
+  if (target >= s98->index_end) {
+    if (s98->loop_offset && period) {
+      // the second pass stands for all later passes
+      uint64_t over = target - s98->length - period;
+      target = s98->length + over % period;
+      loops = over / period + 1;
+    } else {
+      target = s98->index_end;
+    }
+  }
+  size_t lo = 0;
+  size_t hi = s98->index_cnt;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (s98->index[mid].sample <= target) lo = mid;
+    else hi = mid;
+  }
+  const struct s98gen_checkpoint *cp = &s98->index[lo];
+
+  // key off and stop everything playing now
+  for (unsigned c = 0; c < 6; c++) {
+    opna_writereg(&s98->opna, 0x28, (c % 3) | ((c / 3) << 2));
+  }
+  opna_writereg(&s98->opna, 0x10, 0xbf);
+  if (s98->ram_end) {
+    size_t to = cp->offset < s98->ram_end ? cp->offset : s98->ram_end;
+    if (cp->pass) {
+      s98gen_replay_ram(s98, s98->data_offset, s98->ram_end);
+      s98gen_replay_ram(s98, s98->loop_offset, to);
+    } else {
+      s98gen_replay_ram(s98, s98->data_offset, to);
+    }
+  }
+  opna_writereg(&s98->opna, 0x100, 0x01);
+  s98gen_load(s98, cp);
+  s98gen_restore_regs(s98);
+  bool ok = s98gen_run(s98, 0, target - cp->sample) == target - cp->sample;
+  s98->loop_cnt += loops;
+  s98->sample += loops * period;
+  return ok;
+}
@@ -10,6 +10,20 @@
 extern "C" {
 #endif
 
+// parser state at a sync command, with the registers written so far
+struct s98gen_checkpoint {
+  uint64_t sample;
+  size_t offset;
+  uint32_t samples_to_generate;
+  uint16_t samples_to_generate_frac;
+  // 0: before the first loop, 1: in the second pass of the loop
+  uint8_t pass;
+  // 0x28 slot bits of each channel
+  uint8_t keyon[6];
+  // 0x100: not written
+  uint16_t regs[0x200];
+};
+
 struct s98gen {
   struct opna opna;
   uint8_t *s98data;
@@ -20,12 +34,53 @@ struct s98gen {
   uint16_t samples_to_generate_frac;
   uint32_t timer_numerator;
   uint32_t timer_denominator;
+  size_t data_offset;
+  // 0: no loop
+  size_t loop_offset;
+  unsigned loop_cnt;
+  // samples generated or skipped
+  uint64_t sample;
+  // register shadow for seeking, 0x100: not written
+  uint16_t regs[0x200];
+  uint8_t keyon[6];
+  // set by s98gen_build_index
+  struct s98gen_checkpoint *index;
+  size_t index_cnt;
+  // samples until the end command (the first time with a loop)
+  uint64_t length;
+  uint64_t loop_sample;
+  // end of the second pass of the loop
+  uint64_t index_end;
+  // offset after the last adpcm ram write, 0: none
+  size_t ram_end;
 };
 
 // returns true if initialization succeeded
 // returns false without touching *s98 when initialization failed (invalid data)
+// s98data is only read while generating, so it can be a file mapping
 bool s98gen_init(struct s98gen *s98, void *s98data, size_t s98data_size);
-bool s98gen_generate(struct s98gen *s98, int16_t *buf, size_t samples);
+// frees the index
+void s98gen_deinit(struct s98gen *s98);
+// returns the number of samples generated,
+// less than samples when the data ended or is invalid there,
+// the rest of buf is zero
+size_t s98gen_generate(struct s98gen *s98, int16_t *buf, size_t samples);
+// advance without synthesis, see opna_skip
+// returns the number of samples skipped like s98gen_generate
+size_t s98gen_skip(struct s98gen *s98, size_t samples);
+// output sample rate, the chip runs one sample every 144 clocks
+static inline uint32_t s98gen_srate(const struct s98gen *s98) {
+  return (s98->opnaclock + 72) / 144;
+}
+// parses the whole data once without synthesis
+// and saves a checkpoint every interval samples
+// the generating position is not changed
+// returns false when out of memory or the data is invalid
+bool s98gen_build_index(struct s98gen *s98, uint32_t interval);
+// restores the nearest checkpoint before sample and skips to it
+// positions after the end are mapped into the loop
+// notes are keyed on again and the adpcm is stopped
+bool s98gen_seek(struct s98gen *s98, uint64_t sample);
 
 #ifdef __cplusplus
 }
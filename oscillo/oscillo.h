@@ -4,14 +4,23 @@
 #include <stdint.h>
 
 enum {
+  // power of 2
   OSCILLO_SAMPLE_COUNT = 8192,
   OSCILLO_OFFSET_SHIFT = 10,
 };
 
+// ring of the last OSCILLO_SAMPLE_COUNT samples of a track
 struct oscillodata {
   int16_t buf[OSCILLO_SAMPLE_COUNT];
   unsigned offset;
-  
+  // index of the oldest sample, where the next sample is written
+  unsigned head;
 };
 
+// i: 0 for the oldest sample, OSCILLO_SAMPLE_COUNT-1 for the newest
+static inline int16_t oscillo_sample(const struct oscillodata *data,
+                                     unsigned i) {
+  return data->buf[(data->head + i) & (OSCILLO_SAMPLE_COUNT-1)];
+}
+
 #endif // MYON_FMPLAYER_OSCILLO_H_INCLUDED
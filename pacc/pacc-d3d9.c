@@ -49,6 +49,10 @@ struct pacc_buf {
   int len;
   int buflen;
   int bufobjlen;
+  // length kept by buf_rewind
+  int keep;
+  // length in the buffer object, buf mirrors it while !changed
+  int uploaded;
   bool changed;
 };
 
@@ -113,6 +117,20 @@ static bool buf_reserve(struct pacc_buf *pb, int len) {
   return true;
 }
 
+// only marks the buffer changed when the data differs from the upload,
+// so rebuilding the same geometry every frame does not upload it again
+static void buf_append(struct pacc_buf *pb, const float *data, int len) {
+  if (!buf_reserve(pb, len)) return;
+  if (!pb->changed) {
+    if (pb->len + len > pb->uploaded ||
+        memcmp(pb->buf + pb->len, data, len * sizeof(pb->buf[0]))) {
+      pb->changed = true;
+    }
+  }
+  memcpy(pb->buf + pb->len, data, len * sizeof(pb->buf[0]));
+  pb->len += len;
+}
+
 static void pacc_calc_scale(float *ret, int w, int h, int wdest, int hdest) {
   ret[0] = ((float)w) / wdest;
   ret[1] = ((float)h) / hdest;
@@ -154,15 +172,14 @@ static void pacc_buf_rect_off(
      1.0f * scale[0] + off[0],  1.0f * scale[1] - off[1],
      1.0f * tscale[0] + toff[0],  0.0f * tscale[1] + toff[1],
   };
-  if (!buf_reserve(pb, 24)) return;
   int indices[6] = {0, 1, 2, 2, 1, 3};
+  float vert[24];
   for (int i = 0; i < 6; i++) {
     for (int j = 0; j < 4; j++) {
-      pb->buf[pb->len+i*4+j] = coord[indices[i]*4+j];
+      vert[i*4+j] = coord[indices[i]*4+j];
     }
   }
-  pb->len += 24;
-  pb->changed = true;
+  buf_append(pb, vert, 24);
 }
 
 static void pacc_buf_vprintf(
@@ -178,27 +195,26 @@ static void pacc_buf_vprintf(
   pacc_calc_scale(scale, w, h, pc->w, pc->h);
   pacc_calc_off(off, x, y, w, h, pc->w, pc->h);
   if (!buf_reserve(pb, len*24)) return;
-  float *coords = pb->buf + pb->len;
   for (int i = 0; i < len; i++) {
-    coords[24*i+0*4+0]                      = (-1.0f + 2.0f*i) * scale[0] + off[0];
-    coords[24*i+0*4+1]                      = -1.0f * scale[1] - off[1];
-    coords[24*i+1*4+0] = coords[24*i+4*4+0] = (-1.0f + 2.0f*i) * scale[0] + off[0];
-    coords[24*i+1*4+1] = coords[24*i+4*4+1] = 1.0f * scale[1] - off[1];
-    coords[24*i+2*4+0] = coords[24*i+3*4+0] = (1.0f + 2.0f*i) * scale[0] + off[0];
-    coords[24*i+2*4+1] = coords[24*i+3*4+1] = -1.0f * scale[1] - off[1];
-    coords[24*i+5*4+0]                      = (1.0f + 2.0f*i) * scale[0] + off[0];
-    coords[24*i+5*4+1]                      = 1.0f * scale[1] - off[1];
-    coords[24*i+0*4+2]                      = ((float)printbuf[i]) / 256.0f;
-    coords[24*i+0*4+3]                      = 1.0f;
-    coords[24*i+1*4+2] = coords[24*i+4*4+2] = ((float)printbuf[i]) / 256.0f;
-    coords[24*i+1*4+3] = coords[24*i+4*4+3] = 0.0f;
-    coords[24*i+2*4+2] = coords[24*i+3*4+2] = ((float)(printbuf[i]+1)) / 256.0f;
-    coords[24*i+2*4+3] = coords[24*i+3*4+3] = 1.0f;
-    coords[24*i+5*4+2]                      = ((float)(printbuf[i]+1)) / 256.0f;
-    coords[24*i+5*4+3]                      = 0.0f;
+    float coords[24];
+    coords[0*4+0]                 = (-1.0f + 2.0f*i) * scale[0] + off[0];
+    coords[0*4+1]                 = -1.0f * scale[1] - off[1];
+    coords[1*4+0] = coords[4*4+0] = (-1.0f + 2.0f*i) * scale[0] + off[0];
+    coords[1*4+1] = coords[4*4+1] = 1.0f * scale[1] - off[1];
+    coords[2*4+0] = coords[3*4+0] = (1.0f + 2.0f*i) * scale[0] + off[0];
+    coords[2*4+1] = coords[3*4+1] = -1.0f * scale[1] - off[1];
+    coords[5*4+0]                 = (1.0f + 2.0f*i) * scale[0] + off[0];
+    coords[5*4+1]                 = 1.0f * scale[1] - off[1];
+    coords[0*4+2]                 = ((float)printbuf[i]) / 256.0f;
+    coords[0*4+3]                 = 1.0f;
+    coords[1*4+2] = coords[4*4+2] = ((float)printbuf[i]) / 256.0f;
+    coords[1*4+3] = coords[4*4+3] = 0.0f;
+    coords[2*4+2] = coords[3*4+2] = ((float)(printbuf[i]+1)) / 256.0f;
+    coords[2*4+3] = coords[3*4+3] = 1.0f;
+    coords[5*4+2]                 = ((float)(printbuf[i]+1)) / 256.0f;
+    coords[5*4+3]                 = 0.0f;
+    buf_append(pb, coords, 24);
   }
-  pb->len += len * 24;
-  pb->changed = true;
 }
 
 static void pacc_buf_printf(
@@ -218,7 +234,15 @@ static void pacc_buf_rect(
 
 static void pacc_buf_clear(struct pacc_buf *pb) {
   pb->len = 0;
-  pb->changed = true;
+  pb->keep = 0;
+}
+
+static void pacc_buf_keep(struct pacc_buf *pb) {
+  pb->keep = pb->len;
+}
+
+static void pacc_buf_rewind(struct pacc_buf *pb) {
+  pb->len = pb->keep;
 }
 
 static void pacc_palette(struct pacc_ctx *pc, const uint8_t *rgb, int colors) {
@@ -292,7 +316,7 @@ static void pacc_draw(struct pacc_ctx *pc, struct pacc_buf *pb, enum pacc_mode m
     }
     pb->tex->changed = false;
   }
-  if (pb->changed) {
+  if (pb->changed || pb->len != pb->uploaded) {
     if (pb->buflen > pb->bufobjlen) {
       IDirect3DVertexBuffer9 *newbufobj;
       HRESULT res;
@@ -317,6 +341,7 @@ static void pacc_draw(struct pacc_ctx *pc, struct pacc_buf *pb, enum pacc_mode m
             D3DLOCK_DISCARD))) {
       memcpy(objbuf, pb->buf, pb->len*sizeof(pb->buf[0]));
       pb->buf_obj->lpVtbl->Unlock(pb->buf_obj);
+      pb->uploaded = pb->len;
     }
     pb->changed = false;
   }
@@ -476,6 +501,8 @@ static struct pacc_vtable pacc_d3d9_vtable = {
   .buf_vprintf = pacc_buf_vprintf,
   .buf_printf = pacc_buf_printf,
   .buf_clear = pacc_buf_clear,
+  .buf_keep = pacc_buf_keep,
+  .buf_rewind = pacc_buf_rewind,
   .palette = pacc_palette,
   .color = pacc_color,
   .begin_clear = pacc_begin_clear,
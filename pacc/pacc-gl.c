@@ -37,6 +37,16 @@
 
 #endif
 
+// persistently mapped stream buffers with GL 4.4 / ARB_buffer_storage,
+// only looked up on desktop core profiles
+#if defined(PACC_GL_3) && !defined(PACC_GL_ES)
+#define PACC_GL_PERSISTENT
+enum {
+  // frames the GPU may be behind before writing waits
+  PACC_STREAM_SECTIONS = 3,
+};
+#endif
+
 #include "glsl/blit.vert.inc"
 #include "glsl/copy.frag.inc"
 #include "glsl/color.frag.inc"
@@ -54,15 +64,41 @@ struct pacc_ctx {
   uint8_t color;
   bool color_changed;
   enum pacc_mode curr_mode;
+  struct pacc_tex *curr_tex;
+  // all stream buffers share stream_obj and are written into it
+  // together once per frame
+  struct pacc_buf *streams;
+  GLuint stream_obj;
+  GLuint stream_va; // for OpenGL 3.2 Core
+  // in floats, of one section when persistent
+  int stream_size;
+  // orphaning: staging for the single glBufferSubData
+  GLfloat *stage;
+#ifdef PACC_GL_PERSISTENT
+  bool persistent;
+  GLfloat *stream_map;
+  // section with the data of the current frame,
+  // reused after the fence set when leaving it has signaled
+  int section;
+  GLsync fences[PACC_STREAM_SECTIONS];
+#endif
 };
 
 struct pacc_buf {
   GLuint buf_obj;
   GLuint va_obj; // for OpenGL 3.2 Core
+  // stream buffers: in stream_obj from vertex first
+  struct pacc_ctx *pc;
+  struct pacc_buf *next;
+  GLint first;
   GLfloat *buf;
   struct pacc_tex *tex;
   int len;
   int buflen;
+  // length kept by buf_rewind
+  int keep;
+  // length in the buffer object, buf mirrors it while !changed
+  int uploaded;
   GLenum usage;
   bool changed;
 };
@@ -81,10 +117,33 @@ enum {
 enum {
   PACC_BUF_DEF_LEN = 32,
   PRINTBUFLEN = 160,
+  PACC_STREAM_DEF_LEN = 1<<14,
 };
 
+static void stream_delete(struct pacc_ctx *pc) {
+#ifdef PACC_GL_PERSISTENT
+  for (int i = 0; i < PACC_STREAM_SECTIONS; i++) {
+    if (pc->fences[i]) glDeleteSync(pc->fences[i]);
+    pc->fences[i] = 0;
+  }
+  if (pc->stream_map) {
+    glBindBuffer(GL_ARRAY_BUFFER, pc->stream_obj);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    pc->stream_map = 0;
+  }
+#endif
+  glDeleteBuffers(1, &pc->stream_obj);
+  pc->stream_obj = 0;
+  pc->stream_size = 0;
+}
+
 static void pacc_delete(struct pacc_ctx *pc) {
   if (pc) {
+    stream_delete(pc);
+#ifdef PACC_GL_3
+    glDeleteVertexArrays(1, &pc->stream_va);
+#endif
+    free(pc->stage);
     glDeleteTextures(1, &pc->tex_pal);
     for (int i = 0; i < pacc_mode_count; i++) {
       glDeleteProgram(pc->progs[i]);
@@ -177,6 +236,14 @@ err:
 
 static void pacc_buf_delete(struct pacc_buf *pb) {
   if (pb) {
+    if (pb->pc) {
+      for (struct pacc_buf **p = &pb->pc->streams; *p; p = &(*p)->next) {
+        if (*p == pb) {
+          *p = pb->next;
+          break;
+        }
+      }
+    }
     free(pb->buf);
     glDeleteBuffers(1, &pb->buf_obj);
 #ifdef PACC_GL_3
@@ -188,17 +255,21 @@ static void pacc_buf_delete(struct pacc_buf *pb) {
 
 static struct pacc_buf *pacc_gen_buf(
     struct pacc_ctx *pc, struct pacc_tex *pt, enum pacc_buf_mode mode) {
-  (void)pc;
   struct pacc_buf *pb = malloc(sizeof(*pb));
   if (!pb) goto err;
   *pb = (struct pacc_buf) {
     .buflen = PACC_BUF_DEF_LEN,
     .tex = pt,
-    .usage = (mode == pacc_buf_mode_static) ?
-      GL_STATIC_DRAW : GL_STREAM_DRAW,
+    .usage = GL_STATIC_DRAW,
   };
   pb->buf = malloc(sizeof(*pb->buf) * pb->buflen);
   if (!pb->buf) goto err;
+  if (mode == pacc_buf_mode_stream) {
+    pb->pc = pc;
+    pb->next = pc->streams;
+    pc->streams = pb;
+    return pb;
+  }
   glGenBuffers(1, &pb->buf_obj);
   if (!pb->buf_obj) goto err;
 #ifdef PACC_GL_3
@@ -227,6 +298,109 @@ static bool buf_reserve(struct pacc_buf *pb, int len) {
   return true;
 }
 
+// only marks the buffer changed when the data differs from the upload,
+// so rebuilding the same geometry every frame does not upload it again
+static void buf_append(struct pacc_buf *pb, const GLfloat *data, int len) {
+  if (!buf_reserve(pb, len)) return;
+  if (!pb->changed) {
+    if (pb->len + len > pb->uploaded ||
+        memcmp(pb->buf + pb->len, data, len * sizeof(pb->buf[0]))) {
+      pb->changed = true;
+    }
+  }
+  memcpy(pb->buf + pb->len, data, len * sizeof(pb->buf[0]));
+  pb->len += len;
+}
+
+// stream_size floats, for each section when persistent
+static bool stream_alloc(struct pacc_ctx *pc, int size) {
+  stream_delete(pc);
+  glGenBuffers(1, &pc->stream_obj);
+  if (!pc->stream_obj) return false;
+  glBindBuffer(GL_ARRAY_BUFFER, pc->stream_obj);
+#ifdef PACC_GL_PERSISTENT
+  if (pc->persistent) {
+    GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLsizeiptr len = (GLsizeiptr)size * PACC_STREAM_SECTIONS * sizeof(GLfloat);
+    glBufferStorage(GL_ARRAY_BUFFER, len, 0, flags);
+    pc->stream_map = glMapBufferRange(GL_ARRAY_BUFFER, 0, len, flags);
+    if (!pc->stream_map) {
+      DPRINTF("%s\n", "cannot map stream buffer, orphaning instead");
+      pc->persistent = false;
+      return stream_alloc(pc, size);
+    }
+    pc->section = 0;
+  } else
+#endif
+  {
+    GLfloat *stage = realloc(pc->stage, size * sizeof(GLfloat));
+    if (!stage) return false;
+    pc->stage = stage;
+    glBufferData(GL_ARRAY_BUFFER, size * sizeof(GLfloat), 0, GL_STREAM_DRAW);
+  }
+#ifdef PACC_GL_3
+  glBindVertexArray(pc->stream_va);
+  glEnableVertexAttribArray(VAI_COORD);
+  glVertexAttribPointer(VAI_COORD, 4, GL_FLOAT, GL_FALSE, 0, 0);
+#endif
+  pc->stream_size = size;
+  return true;
+}
+
+// writes every stream buffer into stream_obj at once
+// when any of them has changed
+static void stream_upload(struct pacc_ctx *pc) {
+  bool changed = false;
+  int total = 0;
+  for (struct pacc_buf *pb = pc->streams; pb; pb = pb->next) {
+    if (pb->changed || pb->len != pb->uploaded) changed = true;
+    total += pb->len;
+  }
+  if (!changed) return;
+  if (total > pc->stream_size) {
+    int size = PACC_STREAM_DEF_LEN;
+    while (total > size) size *= 2;
+    if (!stream_alloc(pc, size)) return;
+  }
+  GLfloat *dst = pc->stage;
+  int base = 0;
+#ifdef PACC_GL_PERSISTENT
+  if (pc->persistent) {
+    // draws from the current section have all been issued
+    pc->fences[pc->section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pc->section = (pc->section + 1) % PACC_STREAM_SECTIONS;
+    GLsync fence = pc->fences[pc->section];
+    if (fence) {
+      GLenum res;
+      do {
+        res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+      } while (res == GL_TIMEOUT_EXPIRED);
+      glDeleteSync(fence);
+      pc->fences[pc->section] = 0;
+    }
+    base = pc->section * pc->stream_size;
+    dst = pc->stream_map + base;
+  }
+#endif
+  int off = 0;
+  for (struct pacc_buf *pb = pc->streams; pb; pb = pb->next) {
+    memcpy(dst + off, pb->buf, pb->len * sizeof(GLfloat));
+    pb->first = (base + off) / 4;
+    pb->uploaded = pb->len;
+    pb->changed = false;
+    off += pb->len;
+  }
+#ifdef PACC_GL_PERSISTENT
+  if (pc->persistent) return;
+#endif
+  // orphan so the draws of the previous frame keep their data
+  glBindBuffer(GL_ARRAY_BUFFER, pc->stream_obj);
+  glBufferData(GL_ARRAY_BUFFER,
+               pc->stream_size * sizeof(GLfloat), 0, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, total * sizeof(GLfloat), pc->stage);
+}
+
 static void pacc_calc_scale(float *ret, int w, int h, int wdest, int hdest) {
   ret[0] = ((float)w) / wdest;
   ret[1] = ((float)h) / hdest;
@@ -269,15 +443,14 @@ static void pacc_buf_rect_off(
      1.0f * scale[0] + off[0],  1.0f * scale[1] - off[1],
      1.0f * tscale[0] + toff[0],  0.0f * tscale[1] + toff[1],
   };
-  if (!buf_reserve(pb, 24)) return;
   int indices[6] = {0, 1, 2, 2, 1, 3};
+  GLfloat vert[24];
   for (int i = 0; i < 6; i++) {
     for (int j = 0; j < 4; j++) {
-      pb->buf[pb->len+i*4+j] = coord[indices[i]*4+j];
+      vert[i*4+j] = coord[indices[i]*4+j];
     }
   }
-  pb->len += 24;
-  pb->changed = true;
+  buf_append(pb, vert, 24);
 }
 
 static void pacc_buf_vprintf(
@@ -293,27 +466,26 @@ static void pacc_buf_vprintf(
   pacc_calc_scale(scale, w, h, pc->w, pc->h);
   pacc_calc_off(off, x, y, w, h, pc->w, pc->h);
   if (!buf_reserve(pb, len*24)) return;
-  GLfloat *coords = pb->buf + pb->len;
   for (int i = 0; i < len; i++) {
-    coords[24*i+0*4+0]                      = (-1.0f + 2.0f*i) * scale[0] + off[0];
-    coords[24*i+0*4+1]                      = -1.0f * scale[1] - off[1];
-    coords[24*i+1*4+0] = coords[24*i+4*4+0] = (-1.0f + 2.0f*i) * scale[0] + off[0];
-    coords[24*i+1*4+1] = coords[24*i+4*4+1] = 1.0f * scale[1] - off[1];
-    coords[24*i+2*4+0] = coords[24*i+3*4+0] = (1.0f + 2.0f*i) * scale[0] + off[0];
-    coords[24*i+2*4+1] = coords[24*i+3*4+1] = -1.0f * scale[1] - off[1];
-    coords[24*i+5*4+0]                      = (1.0f + 2.0f*i) * scale[0] + off[0];
-    coords[24*i+5*4+1]                      = 1.0f * scale[1] - off[1];
-    coords[24*i+0*4+2]                      = ((float)printbuf[i]) / 256.0f;
-    coords[24*i+0*4+3]                      = 1.0f;
-    coords[24*i+1*4+2] = coords[24*i+4*4+2] = ((float)printbuf[i]) / 256.0f;
-    coords[24*i+1*4+3] = coords[24*i+4*4+3] = 0.0f;
-    coords[24*i+2*4+2] = coords[24*i+3*4+2] = ((float)(printbuf[i]+1)) / 256.0f;
-    coords[24*i+2*4+3] = coords[24*i+3*4+3] = 1.0f;
-    coords[24*i+5*4+2]                      = ((float)(printbuf[i]+1)) / 256.0f;
-    coords[24*i+5*4+3]                      = 0.0f;
+    GLfloat coords[24];
+    coords[0*4+0]                 = (-1.0f + 2.0f*i) * scale[0] + off[0];
+    coords[0*4+1]                 = -1.0f * scale[1] - off[1];
+    coords[1*4+0] = coords[4*4+0] = (-1.0f + 2.0f*i) * scale[0] + off[0];
+    coords[1*4+1] = coords[4*4+1] = 1.0f * scale[1] - off[1];
+    coords[2*4+0] = coords[3*4+0] = (1.0f + 2.0f*i) * scale[0] + off[0];
+    coords[2*4+1] = coords[3*4+1] = -1.0f * scale[1] - off[1];
+    coords[5*4+0]                 = (1.0f + 2.0f*i) * scale[0] + off[0];
+    coords[5*4+1]                 = 1.0f * scale[1] - off[1];
+    coords[0*4+2]                 = ((float)printbuf[i]) / 256.0f;
+    coords[0*4+3]                 = 1.0f;
+    coords[1*4+2] = coords[4*4+2] = ((float)printbuf[i]) / 256.0f;
+    coords[1*4+3] = coords[4*4+3] = 0.0f;
+    coords[2*4+2] = coords[3*4+2] = ((float)(printbuf[i]+1)) / 256.0f;
+    coords[2*4+3] = coords[3*4+3] = 1.0f;
+    coords[5*4+2]                 = ((float)(printbuf[i]+1)) / 256.0f;
+    coords[5*4+3]                 = 0.0f;
+    buf_append(pb, coords, 24);
   }
-  pb->len += len * 24;
-  pb->changed = true;
 }
 
 static void pacc_buf_printf(
@@ -333,7 +505,15 @@ static void pacc_buf_rect(
 
 static void pacc_buf_clear(struct pacc_buf *pb) {
   pb->len = 0;
-  pb->changed = true;
+  pb->keep = 0;
+}
+
+static void pacc_buf_keep(struct pacc_buf *pb) {
+  pb->keep = pb->len;
+}
+
+static void pacc_buf_rewind(struct pacc_buf *pb) {
+  pb->len = pb->keep;
 }
 
 static void pacc_palette(struct pacc_ctx *pc, const uint8_t *rgb, int colors) {
@@ -347,6 +527,8 @@ static void pacc_color(struct pacc_ctx *pc, uint8_t pal) {
 }
 
 static void pacc_begin_clear(struct pacc_ctx *pc) {
+  // the frame is built before it is drawn
+  stream_upload(pc);
   if (pc->pal_changed) {
     glActiveTexture(GL_TEXTURE0);
     glTexImage2D(
@@ -368,6 +550,7 @@ static void pacc_begin_clear(struct pacc_ctx *pc) {
   }
   glClear(GL_COLOR_BUFFER_BIT);
   pc->curr_mode = pacc_mode_count;
+  pc->curr_tex = 0;
 }
 
 static void pacc_draw(struct pacc_ctx *pc, struct pacc_buf *pb, enum pacc_mode mode) {
@@ -382,7 +565,10 @@ static void pacc_draw(struct pacc_ctx *pc, struct pacc_buf *pb, enum pacc_mode m
     glUniform1f(pc->uni_color_trans, pc->color / 255.f);
     pc->color_changed = false;
   }
-  glBindTexture(GL_TEXTURE_2D, pb->tex->tex_obj);
+  if (pc->curr_tex != pb->tex) {
+    glBindTexture(GL_TEXTURE_2D, pb->tex->tex_obj);
+    pc->curr_tex = pb->tex;
+  }
   if (pb->tex->changed) {
     GLint format;
 #if PACC_GL_3
@@ -398,22 +584,37 @@ static void pacc_draw(struct pacc_ctx *pc, struct pacc_buf *pb, enum pacc_mode m
         pb->tex->buf);
     pb->tex->changed = false;
   }
-  if (pb->changed) {
+  GLint first = 0;
+  GLuint buf_obj = pb->buf_obj;
+#ifdef PACC_GL_3
+  GLuint va_obj = pb->va_obj;
+#endif
+  if (pb->pc) {
+    // changed after begin_clear
+    if (pb->changed || pb->len != pb->uploaded) stream_upload(pc);
+    first = pb->first;
+    buf_obj = pc->stream_obj;
+#ifdef PACC_GL_3
+    va_obj = pc->stream_va;
+#endif
+  } else if (pb->changed || pb->len != pb->uploaded) {
     glBindBuffer(GL_ARRAY_BUFFER, pb->buf_obj);
     glBufferData(
         GL_ARRAY_BUFFER,
         pb->len * sizeof(pb->buf[0]), pb->buf,
         pb->usage);
+    pb->uploaded = pb->len;
     pb->changed = false;
   }
 #ifdef PACC_GL_3
-  glBindVertexArray(pb->va_obj);
+  (void)buf_obj;
+  glBindVertexArray(va_obj);
 #else
   glEnableVertexAttribArray(VAI_COORD);
-  glBindBuffer(GL_ARRAY_BUFFER, pb->buf_obj);
+  glBindBuffer(GL_ARRAY_BUFFER, buf_obj);
   glVertexAttribPointer(VAI_COORD, 4, GL_FLOAT, GL_FALSE, 0, 0);
 #endif
-  glDrawArrays(GL_TRIANGLES, 0, pb->len / 4);
+  glDrawArrays(GL_TRIANGLES, first, pb->len / 4);
 }
 
 static uint8_t *pacc_tex_lock(struct pacc_tex *pt) {
@@ -433,7 +634,7 @@ static void pacc_tex_delete(struct pacc_tex *pt) {
 }
 
 static struct pacc_tex *pacc_gen_tex(struct pacc_ctx *pc, int w, int h) {
-  (void)pc;
+  pc->curr_tex = 0;
   struct pacc_tex *pt = malloc(sizeof(*pt));
   if (!pt) goto err;
   *pt = (struct pacc_tex) {
@@ -470,6 +671,23 @@ err:
   return 0;
 }
 
+#ifdef PACC_GL_PERSISTENT
+static bool has_buffer_storage(void) {
+  if (!glBufferStorage) return false;
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (major > 4 || (major == 4 && minor >= 4)) return true;
+  GLint cnt = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &cnt);
+  for (GLint i = 0; i < cnt; i++) {
+    const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+    if (ext && !strcmp(ext, "GL_ARB_buffer_storage")) return true;
+  }
+  return false;
+}
+#endif
+
 static void pacc_viewport_scale(struct pacc_ctx *pc, int scale) {
   glViewport(0, 0, pc->w*scale, pc->h*scale);
 }
@@ -487,6 +705,8 @@ static struct pacc_vtable pacc_gl_vtable = {
   .buf_vprintf = pacc_buf_vprintf,
   .buf_printf = pacc_buf_printf,
   .buf_clear = pacc_buf_clear,
+  .buf_keep = pacc_buf_keep,
+  .buf_rewind = pacc_buf_rewind,
   .palette = pacc_palette,
   .color = pacc_color,
   .begin_clear = pacc_begin_clear,
@@ -520,6 +740,13 @@ struct pacc_ctx *pacc_init_gl(int w, int h, struct pacc_vtable *vt) {
   if (!pc->progs[pacc_mode_color_trans]) goto err;
   pc->uni_color = glGetUniformLocation(pc->progs[pacc_mode_color], "color");
   pc->uni_color_trans = glGetUniformLocation(pc->progs[pacc_mode_color_trans], "color");
+#ifdef PACC_GL_3
+  glGenVertexArrays(1, &pc->stream_va);
+  if (!pc->stream_va) goto err;
+#endif
+#ifdef PACC_GL_PERSISTENT
+  pc->persistent = has_buffer_storage();
+#endif
   glActiveTexture(GL_TEXTURE1);
   *vt = pacc_gl_vtable;
   return pc;
@@ -0,0 +1,340 @@
+#include "pacc-sw.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PACC_SW_SSE2
+#endif
+
+struct pacc_ctx {
+  int w;
+  int h;
+  uint8_t pal[256*3];
+  uint8_t color;
+  uint8_t *fb;
+  // one texture row when it wraps or clamps
+  uint8_t *rowbuf;
+};
+
+struct pacc_rect {
+  int16_t x, y, w, h;
+  int16_t tx, ty;
+};
+
+struct pacc_buf {
+  struct pacc_tex *tex;
+  struct pacc_rect *rects;
+  int len;
+  int buflen;
+  // length kept by buf_rewind
+  int keep;
+};
+
+struct pacc_tex {
+  int w, h;
+  // power of 2 sizes repeat, others clamp to edge, like the GL backend
+  bool wrap_w, wrap_h;
+  uint8_t *buf;
+};
+
+enum {
+  PACC_BUF_DEF_LEN = 8,
+  PRINTBUFLEN = 160,
+};
+
+static void pacc_delete(struct pacc_ctx *pc) {
+  if (pc) {
+    free(pc->fb);
+    free(pc->rowbuf);
+    free(pc);
+  }
+}
+
+static void pacc_buf_delete(struct pacc_buf *pb) {
+  if (pb) {
+    free(pb->rects);
+    free(pb);
+  }
+}
+
+static struct pacc_buf *pacc_gen_buf(
+    struct pacc_ctx *pc, struct pacc_tex *pt, enum pacc_buf_mode mode) {
+  (void)pc;
+  (void)mode;
+  struct pacc_buf *pb = malloc(sizeof(*pb));
+  if (!pb) goto err;
+  *pb = (struct pacc_buf) {
+    .buflen = PACC_BUF_DEF_LEN,
+    .tex = pt,
+  };
+  pb->rects = malloc(sizeof(*pb->rects) * pb->buflen);
+  if (!pb->rects) goto err;
+  return pb;
+err:
+  pacc_buf_delete(pb);
+  return 0;
+}
+
+static bool buf_reserve(struct pacc_buf *pb, int len) {
+  if (pb->len + len > pb->buflen) {
+    int newlen = pb->buflen;
+    while (pb->len + len > newlen) newlen *= 2;
+    struct pacc_rect *newrects =
+      realloc(pb->rects, newlen * sizeof(pb->rects[0]));
+    if (!newrects) return false;
+    pb->buflen = newlen;
+    pb->rects = newrects;
+  }
+  return true;
+}
+
+static void pacc_buf_rect_off(
+    const struct pacc_ctx *pc, struct pacc_buf *pb,
+    int x, int y, int w, int h, int xoff, int yoff) {
+  (void)pc;
+  if (!w && !h) return;
+  if (!buf_reserve(pb, 1)) return;
+  pb->rects[pb->len++] = (struct pacc_rect) {
+    .x = x, .y = y, .w = w, .h = h, .tx = xoff, .ty = yoff,
+  };
+}
+
+static void pacc_buf_vprintf(
+    const struct pacc_ctx *pc, struct pacc_buf *pb,
+    int x, int y, const char *fmt, va_list ap) {
+  (void)pc;
+  uint8_t printbuf[PRINTBUFLEN+1];
+  vsnprintf((char *)printbuf, sizeof(printbuf), fmt, ap);
+  int len = strlen((const char *)printbuf);
+  int w = pb->tex->w / 256;
+  int h = pb->tex->h;
+  if (!buf_reserve(pb, len)) return;
+  for (int i = 0; i < len; i++) {
+    pb->rects[pb->len++] = (struct pacc_rect) {
+      .x = x + w*i, .y = y, .w = w, .h = h, .tx = printbuf[i]*w, .ty = 0,
+    };
+  }
+}
+
+static void pacc_buf_printf(
+    const struct pacc_ctx *pc, struct pacc_buf *pb,
+    int x, int y, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  pacc_buf_vprintf(pc, pb, x, y, fmt, ap);
+  va_end(ap);
+}
+
+static void pacc_buf_rect(
+    const struct pacc_ctx *pc, struct pacc_buf *pb,
+    int x, int y, int w, int h) {
+  pacc_buf_rect_off(pc, pb, x, y, w, h, 0, 0);
+}
+
+static void pacc_buf_clear(struct pacc_buf *pb) {
+  pb->len = 0;
+  pb->keep = 0;
+}
+
+static void pacc_buf_keep(struct pacc_buf *pb) {
+  pb->keep = pb->len;
+}
+
+static void pacc_buf_rewind(struct pacc_buf *pb) {
+  pb->len = pb->keep;
+}
+
+static void pacc_palette(struct pacc_ctx *pc, const uint8_t *rgb, int colors) {
+  memcpy(pc->pal, rgb, colors*3);
+}
+
+static void pacc_color(struct pacc_ctx *pc, uint8_t pal) {
+  pc->color = pal;
+}
+
+static void pacc_begin_clear(struct pacc_ctx *pc) {
+  memset(pc->fb, 0, pc->w * pc->h);
+}
+
+// texture nonzero: color, zero: 0
+static void span_color(uint8_t *dst, const uint8_t *src, int w, uint8_t c) {
+  int i = 0;
+#ifdef PACC_SW_SSE2
+  __m128i z = _mm_setzero_si128();
+  __m128i cv = _mm_set1_epi8(c);
+  for (; i + 16 <= w; i += 16) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i zero = _mm_cmpeq_epi8(s, z);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_andnot_si128(zero, cv));
+  }
+#endif
+  for (; i < w; i++) dst[i] = src[i] ? c : 0;
+}
+
+// texture nonzero: color, zero: transparent
+static void span_color_trans(uint8_t *dst, const uint8_t *src, int w, uint8_t c) {
+  int i = 0;
+#ifdef PACC_SW_SSE2
+  __m128i z = _mm_setzero_si128();
+  __m128i cv = _mm_set1_epi8(c);
+  for (; i + 16 <= w; i += 16) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+    __m128i zero = _mm_cmpeq_epi8(s, z);
+    __m128i r = _mm_or_si128(_mm_and_si128(zero, d),
+                             _mm_andnot_si128(zero, cv));
+    _mm_storeu_si128((__m128i *)(dst + i), r);
+  }
+#endif
+  for (; i < w; i++) if (src[i]) dst[i] = c;
+}
+
+static int tex_coord(int c, int len, bool wrap) {
+  if (wrap) return c & (len - 1);
+  if (c < 0) return 0;
+  if (c >= len) return len - 1;
+  return c;
+}
+
+static void draw_rect(struct pacc_ctx *pc, const struct pacc_tex *pt,
+                      const struct pacc_rect *r, enum pacc_mode mode) {
+  int x0 = r->x, y0 = r->y, x1 = r->x + r->w, y1 = r->y + r->h;
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > pc->w) x1 = pc->w;
+  if (y1 > pc->h) y1 = pc->h;
+  if (x0 >= x1 || y0 >= y1) return;
+  int w = x1 - x0;
+  int tx = r->tx + (x0 - r->x);
+  bool direct = tx >= 0 && tx + w <= pt->w;
+  for (int y = y0; y < y1; y++) {
+    int ty = tex_coord(r->ty + (y - r->y), pt->h, pt->wrap_h);
+    const uint8_t *trow = pt->buf + ty * pt->w;
+    const uint8_t *src = trow + tx;
+    if (!direct) {
+      for (int i = 0; i < w; i++) {
+        pc->rowbuf[i] = trow[tex_coord(tx + i, pt->w, pt->wrap_w)];
+      }
+      src = pc->rowbuf;
+    }
+    uint8_t *dst = pc->fb + y * pc->w + x0;
+    switch (mode) {
+    case pacc_mode_copy:
+      memcpy(dst, src, w);
+      break;
+    case pacc_mode_color:
+      span_color(dst, src, w, pc->color);
+      break;
+    case pacc_mode_color_trans:
+      span_color_trans(dst, src, w, pc->color);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+static void pacc_draw(struct pacc_ctx *pc, struct pacc_buf *pb, enum pacc_mode mode) {
+  if (mode >= pacc_mode_count) return;
+  for (int i = 0; i < pb->len; i++) {
+    draw_rect(pc, pb->tex, &pb->rects[i], mode);
+  }
+}
+
+static uint8_t *pacc_tex_lock(struct pacc_tex *pt) {
+  return pt->buf;
+}
+
+static void pacc_tex_unlock(struct pacc_tex *pt) {
+  (void)pt;
+}
+
+static void pacc_tex_delete(struct pacc_tex *pt) {
+  if (pt) {
+    free(pt->buf);
+    free(pt);
+  }
+}
+
+static struct pacc_tex *pacc_gen_tex(struct pacc_ctx *pc, int w, int h) {
+  (void)pc;
+  struct pacc_tex *pt = malloc(sizeof(*pt));
+  if (!pt) goto err;
+  *pt = (struct pacc_tex) {
+    .w = w,
+    .h = h,
+    .wrap_w = !(w & (w - 1)),
+    .wrap_h = !(h & (h - 1)),
+    .buf = calloc(w*h, 1),
+  };
+  if (!pt->buf) goto err;
+  return pt;
+err:
+  pacc_tex_delete(pt);
+  return 0;
+}
+
+static void pacc_viewport_scale(struct pacc_ctx *pc, int scale) {
+  // scaling is up to whoever consumes the framebuffer
+  (void)pc;
+  (void)scale;
+}
+
+static struct pacc_vtable pacc_sw_vtable = {
+  .pacc_delete = pacc_delete,
+  .gen_buf = pacc_gen_buf,
+  .gen_tex = pacc_gen_tex,
+  .buf_delete = pacc_buf_delete,
+  .tex_lock = pacc_tex_lock,
+  .tex_unlock = pacc_tex_unlock,
+  .tex_delete = pacc_tex_delete,
+  .buf_rect = pacc_buf_rect,
+  .buf_rect_off = pacc_buf_rect_off,
+  .buf_vprintf = pacc_buf_vprintf,
+  .buf_printf = pacc_buf_printf,
+  .buf_clear = pacc_buf_clear,
+  .buf_keep = pacc_buf_keep,
+  .buf_rewind = pacc_buf_rewind,
+  .palette = pacc_palette,
+  .color = pacc_color,
+  .begin_clear = pacc_begin_clear,
+  .draw = pacc_draw,
+  .viewport_scale = pacc_viewport_scale,
+};
+
+struct pacc_ctx *pacc_init_sw(int w, int h, struct pacc_vtable *vt) {
+  struct pacc_ctx *pc = malloc(sizeof(*pc));
+  if (!pc) goto err;
+  *pc = (struct pacc_ctx) {
+    .w = w,
+    .h = h,
+    .fb = calloc(w*h, 1),
+    .rowbuf = malloc(w),
+  };
+  if (!pc->fb || !pc->rowbuf) goto err;
+  *vt = pacc_sw_vtable;
+  return pc;
+err:
+  pacc_delete(pc);
+  return 0;
+}
+
+const uint8_t *pacc_sw_framebuffer(const struct pacc_ctx *pc) {
+  return pc->fb;
+}
+
+const uint8_t *pacc_sw_palette(const struct pacc_ctx *pc) {
+  return pc->pal;
+}
+
+void pacc_sw_rgb(const struct pacc_ctx *pc, uint8_t *rgb, int stride) {
+  for (int y = 0; y < pc->h; y++) {
+    const uint8_t *src = pc->fb + y * pc->w;
+    uint8_t *dst = rgb + y * stride;
+    for (int x = 0; x < pc->w; x++) {
+      memcpy(dst + x*3, pc->pal + src[x]*3, 3);
+    }
+  }
+}
@@ -0,0 +1,16 @@
+#ifndef MYON_PACC_SW_H_INCLUDED
+#define MYON_PACC_SW_H_INCLUDED
+
+#include "pacc.h"
+
+// software renderer into an 8-bit indexed framebuffer in memory,
+// no GPU or window is needed
+struct pacc_ctx *pacc_init_sw(int w, int h, struct pacc_vtable *vt);
+// w*h palette indices, valid until the next draw
+const uint8_t *pacc_sw_framebuffer(const struct pacc_ctx *pc);
+// current 256 entry RGB palette
+const uint8_t *pacc_sw_palette(const struct pacc_ctx *pc);
+// converts the framebuffer to packed RGB, stride in bytes
+void pacc_sw_rgb(const struct pacc_ctx *pc, uint8_t *rgb, int stride);
+
+#endif // MYON_PACC_SW_H_INCLUDED
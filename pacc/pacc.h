@@ -42,6 +42,10 @@ struct pacc_vtable {
       const struct pacc_ctx *ctx, struct pacc_buf *buf,
       int x, int y, const char *fmt, ...);
   void (*buf_clear)(struct pacc_buf *buf);
+  // buf_rewind drops what was added after the last buf_keep,
+  // buf_clear drops everything
+  void (*buf_keep)(struct pacc_buf *buf);
+  void (*buf_rewind)(struct pacc_buf *buf);
   void (*palette)(struct pacc_ctx *ctx, const uint8_t *rgb, int colors);
   void (*color)(struct pacc_ctx *ctx, uint8_t pal);
   void (*begin_clear)(struct pacc_ctx *ctx);
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "libopna/s98gen.h"
+
+enum {
+  BUFFRAMES = 4096,
+};
+
+static void write16le(uint8_t *ptr, uint16_t data) {
+  ptr[0] = data;
+  ptr[1] = data >> 8;
+}
+
+static void write32le(uint8_t *ptr, uint32_t data) {
+  ptr[0] = data;
+  ptr[1] = data >> 8;
+  ptr[2] = data >> 16;
+  ptr[3] = data >> 24;
+}
+
+static bool write_header(FILE *file, uint32_t srate, uint32_t frames) {
+  uint8_t waveheader[44] = {0};
+  memcpy(waveheader, "RIFF", 4);
+  write32le(waveheader+4, frames * 4 + 4 + 8 + 16 + 8);
+  memcpy(waveheader+8, "WAVE", 4);
+  memcpy(waveheader+12, "fmt ", 4);
+  write32le(waveheader+16, 16);
+  write16le(waveheader+20, 1);
+  write16le(waveheader+22, 2);
+  write32le(waveheader+24, srate);
+  write32le(waveheader+28, srate * 2 * 2);
+  write16le(waveheader+32, 4);
+  write16le(waveheader+34, 16);
+  memcpy(waveheader+36, "data", 4);
+  write32le(waveheader+40, frames * 4);
+  return fwrite(waveheader, 1, sizeof(waveheader), file) == sizeof(waveheader);
+}
+
+static bool readrom(struct opna *opna, const char *path) {
+  FILE *rhythm = fopen(path, "rb");
+  if (!rhythm) goto err;
+  uint8_t data[OPNA_ROM_SIZE];
+  if (fread(data, 1, OPNA_ROM_SIZE, rhythm) != OPNA_ROM_SIZE) goto err_file;
+  static struct opna_drum_rom drumrom;
+  opna_drum_rom_decode(&drumrom, data);
+  opna_drum_set_rom(&opna->drum, &drumrom);
+  fclose(rhythm);
+  return true;
+err_file:
+  fclose(rhythm);
+err:
+  return false;
+}
+
+static void help(const char *name) {
+  fprintf(stderr, "Usage: %s [options] file.s98 out.wav\n", name);
+  fprintf(stderr, "  options:\n");
+  fprintf(stderr, "  -h        show help\n");
+  fprintf(stderr, "  -r file   rhythm rom (ym2608_adpcm_rom.bin)\n");
+  fprintf(stderr, "  -s sec    start position\n");
+  fprintf(stderr, "  -l sec    length (default: until the end or two loops)\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  int optchar;
+  const char *rompath = 0;
+  double start = 0.0;
+  double length = -1.0;
+  while ((optchar = getopt(argc, argv, "hr:s:l:")) != -1) {
+    switch (optchar) {
+    case 'r':
+      rompath = optarg;
+      break;
+    case 's':
+      start = atof(optarg);
+      break;
+    case 'l':
+      length = atof(optarg);
+      break;
+    default:
+    case 'h':
+      help(argv[0]);
+      break;
+    }
+  }
+  if (argc != optind + 2) {
+    fprintf(stderr, "invalid arguments\n");
+    help(argv[0]);
+  }
+  int fd = open(argv[optind], O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "cannot open file\n");
+    return 1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || !st.st_size) {
+    fprintf(stderr, "cannot get file size\n");
+    return 1;
+  }
+  // pages are read as the data is parsed
+  void *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "cannot map file\n");
+    return 1;
+  }
+  static struct s98gen s98;
+  static uint8_t adpcm_ram[OPNA_ADPCM_RAM_SIZE];
+  if (!s98gen_init(&s98, data, st.st_size)) {
+    fprintf(stderr, "invalid S98 file\n");
+    return 1;
+  }
+  opna_adpcm_set_ram_256k(&s98.opna.adpcm, adpcm_ram);
+  if (rompath && !readrom(&s98.opna, rompath)) {
+    fprintf(stderr, "cannot load rhythm rom\n");
+  }
+  // 55467 Hz for the usual 7987200 Hz clock
+  uint32_t srate = s98gen_srate(&s98);
+  // one checkpoint per second
+  if (!s98gen_build_index(&s98, srate)) {
+    fprintf(stderr, "invalid S98 data\n");
+    return 1;
+  }
+  uint64_t startframe = start > 0.0 ? (uint64_t)(start * srate) : 0;
+  uint64_t frames = length >= 0.0 ? (uint64_t)(length * srate) :
+                    s98.index_end > startframe ? s98.index_end - startframe : 0;
+  if (frames > ((UINT32_MAX - 44) / 4)) frames = (UINT32_MAX - 44) / 4;
+  if (startframe && !s98gen_seek(&s98, startframe)) {
+    fprintf(stderr, "cannot seek\n");
+    return 1;
+  }
+  FILE *file = fopen(argv[optind+1], "wb");
+  if (!file) {
+    fprintf(stderr, "cannot open output file\n");
+    return 1;
+  }
+  bool ok = write_header(file, srate, frames);
+  static int16_t buf[BUFFRAMES*2];
+  while (ok && frames) {
+    unsigned n = frames < BUFFRAMES ? frames : BUFFRAMES;
+    // after the end the rest is silence, s98gen_generate zeroes it
+    s98gen_generate(&s98, buf, n);
+    ok = fwrite(buf, 4, n, file) == n;
+    frames -= n;
+  }
+  ok = !fclose(file) && ok;
+  s98gen_deinit(&s98);
+  munmap(data, st.st_size);
+  if (!ok) {
+    fprintf(stderr, "cannot write output file\n");
+    return 1;
+  }
+  return 0;
+}
@@ -18,6 +18,10 @@
 #include "common/fmplayer_file.h"
 #include "common/fmplayer_common.h"
 #include "common/fmplayer_fontrom.h"
+#include "common/fmplayer_checkpoint.h"
+#include "common/fmplayer_ring.h"
+#include "common/fmplayer_spectrum.h"
+#include "common/fmplayer_snapshot.h"
 #include "fft/fft.h"
 
 bool loadgl(void);
@@ -25,6 +29,13 @@ bool loadgl(void);
 enum {
   SRATE = 55467,
   BUFLEN = 1024,
+  // synthesis runs this far ahead of the audio callback
+  LOOKAHEAD = BUFLEN*4,
+  RING_FRAMES = 1<<14,
+  SYNTH_FRAMES = 1024,
+  // spectrum transform interval
+  SPECTRUM_HOP = 1024,
+  SEEK_SEC = 5,
 };
 
 static struct {
@@ -32,34 +43,89 @@ static struct {
   struct opna_timer timer;
   struct fmdriver_work work;
   struct fmplayer_file *fmfile;
-  struct fmplayer_fft_data fftdata;
-  struct fmplayer_fft_input_data fftin;
+  struct fmplayer_checkpoint_index checkpoints;
+  struct fmplayer_spectrum spectrum;
+  // published under synth_mutex, read by fmdsp without locking
+  struct fmplayer_snapshots snapshots;
+  // only touched by the synthesis thread
+  struct oscillodata oscillo[LIBOPNA_OSCILLO_TRACK_COUNT];
   const char *lastopenpath;
   SDL_Window *win;
   SDL_AudioDeviceID adev;
   struct ppz8 ppz8;
   char adpcmram[OPNA_ADPCM_RAM_SIZE];
   struct fmdsp_pacc *fp;
-  atomic_flag fftdata_flag;
   int scale;
   struct fmdsp_font font16;
   bool paused;
+  struct fmplayer_ring ring;
+  SDL_Thread *synth_thread;
+  SDL_mutex *synth_mutex;
+  SDL_sem *synth_sem;
+  atomic_bool synth_exit;
+  SDL_Thread *spectrum_thread;
+  SDL_sem *spectrum_sem;
+  atomic_bool spectrum_exit;
 } g = {
-  .fftdata_flag = ATOMIC_FLAG_INIT,
   .scale = 1,
 };
 
+// runs the driver and the chip ahead into g.ring
+static int synth_thread(void *ptr) {
+  (void)ptr;
+  while (!atomic_load_explicit(&g.synth_exit, memory_order_acquire)) {
+    SDL_LockMutex(g.synth_mutex);
+    unsigned frames = SYNTH_FRAMES;
+    int16_t *buf = fmplayer_ring_write_begin(&g.ring, &frames);
+    if (frames) {
+      memset(buf, 0, sizeof(int16_t)*frames*2);
+      opna_timer_mix_oscillo(&g.timer, buf, frames, g.oscillo);
+      fmplayer_spectrum_write_tracks(&g.spectrum, g.oscillo);
+      fmplayer_checkpoint_update(&g.checkpoints);
+      fmplayer_snapshots_publish(&g.snapshots, &g.work, &g.opna);
+      fmplayer_ring_write_commit(&g.ring, frames);
+    }
+    SDL_UnlockMutex(g.synth_mutex);
+    // woken up by the audio callback
+    if (!frames) SDL_SemWaitTimeout(g.synth_sem, 10);
+  }
+  return 0;
+}
+
+// computes the spectrum of what the audio callback played
+static int spectrum_thread(void *ptr) {
+  (void)ptr;
+  while (!atomic_load_explicit(&g.spectrum_exit, memory_order_acquire)) {
+    fmplayer_spectrum_run(&g.spectrum);
+    // woken up by the audio callback
+    SDL_SemWaitTimeout(g.spectrum_sem, 100);
+  }
+  return 0;
+}
+
+// stops the synthesis and the audio callback,
+// and drops what was rendered ahead
+static void synth_lock(void) {
+  SDL_LockAudioDevice(g.adev);
+  SDL_LockMutex(g.synth_mutex);
+  fmplayer_ring_flush(&g.ring);
+}
+
+static void synth_unlock(void) {
+  SDL_UnlockMutex(g.synth_mutex);
+  SDL_UnlockAudioDevice(g.adev);
+}
+
 static void audiocb(void *ptr, Uint8 *bufptr, int len) {
   (void)ptr;
-  int frames = len / (sizeof(int16_t)*2);
+  unsigned frames = len / (sizeof(int16_t)*2);
   int16_t *buf = (int16_t *)bufptr;
-  memset(buf, 0, len);
-  opna_timer_mix(&g.timer, buf, frames);
-  if (!atomic_flag_test_and_set_explicit(
-        &g.fftdata_flag, memory_order_acquire)) {
-    fft_write(&g.fftdata, buf, frames);
-    atomic_flag_clear_explicit(&g.fftdata_flag, memory_order_release);
-  }
+  unsigned read = fmplayer_ring_read(&g.ring, buf, frames);
+  // underrun
+  memset(buf + read*2, 0, (frames - read)*sizeof(int16_t)*2);
+  SDL_SemPost(g.synth_sem);
+  fmplayer_spectrum_write(&g.spectrum, buf, frames);
+  SDL_SemPost(g.spectrum_sem);
 }
 
 static void openfile(const char *path) {
@@ -73,11 +139,14 @@ static void openfile(const char *path) {
         g.win);
     goto err;
   }
-  if (g.adev) SDL_LockAudioDevice(g.adev);
+  if (g.adev) synth_lock();
   fmplayer_file_free(g.fmfile);
   g.fmfile = file;
   fmplayer_init_work_opna(&g.work, &g.ppz8, &g.opna, &g.timer, &g.adpcmram);
   fmplayer_file_load(&g.work, g.fmfile, 1);
+  fmplayer_checkpoint_deinit(&g.checkpoints);
+  fmplayer_checkpoint_init_file(&g.checkpoints, &g.work, &g.timer, &g.ppz8, g.fmfile);
+  fmplayer_snapshots_publish(&g.snapshots, &g.work, &g.opna);
   if (g.fmfile->filename_sjis) {
     fmdsp_pacc_set_filename_sjis(g.fp, g.fmfile->filename_sjis);
   }
@@ -100,8 +169,19 @@ static void openfile(const char *path) {
         g.win);
       goto err;
     }
+    g.synth_thread = SDL_CreateThread(synth_thread, "synth", 0);
+    if (!g.synth_thread) {
+      SDL_ShowSimpleMessageBox(
+        SDL_MESSAGEBOX_ERROR,
+        "cannot create synthesis thread",
+        SDL_GetError(),
+        g.win);
+      SDL_CloseAudioDevice(g.adev);
+      g.adev = 0;
+      goto err;
+    }
   } else {
-    SDL_UnlockAudioDevice(g.adev);
+    synth_unlock();
   }
   SDL_PauseAudioDevice(g.adev, 0);
   g.paused = false;
@@ -149,6 +229,20 @@ static void mask_set(int p, bool shift, bool control) {
   }
 }
 
+static void seek(bool forward) {
+  if (!g.adev) return;
+  synth_lock();
+  uint32_t ticks = fmplayer_checkpoint_sec_ticks(&g.checkpoints, SEEK_SEC);
+  uint32_t pos = g.work.timerb_cnt;
+  if (forward) {
+    pos += ticks;
+  } else {
+    pos = (pos > ticks) ? pos - ticks : 0;
+  }
+  fmplayer_checkpoint_seek(&g.checkpoints, pos);
+  synth_unlock();
+}
+
 static void handle_keydown(
   const SDL_KeyboardEvent *key,
   const struct pacc_vtable *pacc,
@@ -168,10 +262,19 @@ static void handle_keydown(
       case SDL_SCANCODE_F7:
 	if (g.adev) {
 	  g.paused ^= 1;
+	  // nothing is synthesized while paused, publish it here
+	  SDL_LockMutex(g.synth_mutex);
 	  g.work.paused = g.paused;
+	  fmplayer_snapshots_publish(&g.snapshots, &g.work, &g.opna);
+	  SDL_UnlockMutex(g.synth_mutex);
 	  SDL_PauseAudioDevice(g.adev, g.paused);
 	}
 	break;
+      case SDL_SCANCODE_F10:
+	// mix, then each track
+	fmdsp_pacc_set_spectrum_track(
+	  g.fp, fmdsp_pacc_spectrum_track(g.fp) + 1);
+	break;
       case SDL_SCANCODE_F11:
 	if (key->keysym.mod & KMOD_SHIFT) {
 	  fmdsp_pacc_set_right_mode(
@@ -221,6 +324,18 @@ static void handle_keydown(
   default:
     break;
   }
+  if (!(key->keysym.mod & KMOD_SHIFT)) {
+    switch (key->keysym.scancode) {
+    case SDL_SCANCODE_LEFT:
+      seek(false);
+      break;
+    case SDL_SCANCODE_RIGHT:
+      seek(true);
+      break;
+    default:
+      break;
+    }
+  }
   if (key->keysym.mod & KMOD_SHIFT) {
     switch (key->keysym.scancode) {
     case SDL_SCANCODE_UP:
@@ -241,11 +356,29 @@ int main(int argc, char **argv) {
 #ifdef ENABLE_SSE
   if (__builtin_cpu_supports("sse2")) opna_ssg_sinc_calc_func = opna_ssg_sinc_calc_sse2;
 #endif
-  fft_init_table();
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
     SDL_Log("Cannot initialize SDL\n");
     return 1;
   }
+  if (!fmplayer_ring_init(&g.ring, RING_FRAMES, LOOKAHEAD)) {
+    SDL_Log("Cannot allocate audio buffer\n");
+    SDL_Quit();
+    return 1;
+  }
+  if (!fmplayer_spectrum_init(&g.spectrum, SPECTRUM_HOP)) {
+    SDL_Log("Cannot allocate spectrum buffer\n");
+    SDL_Quit();
+    return 1;
+  }
+  fmplayer_snapshots_init(&g.snapshots);
+  g.synth_mutex = SDL_CreateMutex();
+  g.synth_sem = SDL_CreateSemaphore(0);
+  g.spectrum_sem = SDL_CreateSemaphore(0);
+  if (!g.synth_mutex || !g.synth_sem || !g.spectrum_sem) {
+    SDL_Log("Cannot create synthesis thread objects\n");
+    SDL_Quit();
+    return 1;
+  }
 
   SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
   SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
@@ -321,7 +454,15 @@ int main(int argc, char **argv) {
     SDL_Quit();
     return 1;
   }
-  fmdsp_pacc_set(g.fp, &g.work, &g.opna, &g.fftin);
+  fmdsp_pacc_set(g.fp, &g.work, &g.opna, 0);
+  fmdsp_pacc_set_spectrum(g.fp, &g.spectrum);
+  fmdsp_pacc_set_snapshots(g.fp, &g.snapshots);
+  g.spectrum_thread = SDL_CreateThread(spectrum_thread, "spectrum", 0);
+  if (!g.spectrum_thread) {
+    SDL_Log("Cannot create spectrum thread\n");
+    SDL_Quit();
+    return 1;
+  }
   fmplayer_font_rom_load(&g.font16);
   fmdsp_pacc_set_font16(g.fp, &g.font16);
 
@@ -343,15 +484,19 @@ int main(int argc, char **argv) {
 	handle_keydown(&e.key, &pacc, pc);
       }
     }
-    if (!atomic_flag_test_and_set_explicit(
-          &g.fftdata_flag, memory_order_acquire)) {
-      memcpy(&g.fftin.fdata, &g.fftdata, sizeof(g.fftdata));
-      atomic_flag_clear_explicit(&g.fftdata_flag, memory_order_release);
-    }
     fmdsp_pacc_render(g.fp);
     SDL_GL_SwapWindow(g.win);
   }
 
+  if (g.synth_thread) {
+    SDL_PauseAudioDevice(g.adev, 1);
+    atomic_store_explicit(&g.synth_exit, true, memory_order_release);
+    SDL_SemPost(g.synth_sem);
+    SDL_WaitThread(g.synth_thread, 0);
+  }
+  atomic_store_explicit(&g.spectrum_exit, true, memory_order_release);
+  SDL_SemPost(g.spectrum_sem);
+  SDL_WaitThread(g.spectrum_thread, 0);
   fmdsp_pacc_release(g.fp);
   pacc.pacc_delete(pc);
 
@@ -27,20 +27,26 @@ bool loadgl(void) {
 #else // PACC_GL_ES
 #include <SDL.h>
 #define PROC(N, n) static PFNGL##N##PROC gl##n;
+#define PROC_OPT(N, n) PROC(N, n)
 #include "pacc/pacc-gl-procs.inc"
 #undef PROC
+#undef PROC_OPT
 #define PROC(N, n) \
   gl##n = SDL_GL_GetProcAddress("gl" #n);\
   if (!gl##n) {\
     SDL_Log("Cannot load GL function \"gl" #n "\"\n");\
     return false;\
   }
+// the backend checks the version or extension before using these
+#define PROC_OPT(N, n) \
+  gl##n = SDL_GL_GetProcAddress("gl" #n);
 
 bool loadgl(void) {
 #include "pacc/pacc-gl-procs.inc"
   return true;
 }
 #undef PROC
+#undef PROC_OPT
 #endif // PACC_GL_ES
 
 #ifdef PROC_NO_GL_1_1
@@ -20,14 +20,86 @@ struct alsaout_state {
   int fd_event;
   int fds_space;
   struct pollfd *fds;
-  bool paused;
+  atomic_bool paused;
   bool terminate;
-  atomic_flag cb_flag;
+  // set while the callback runs
+  atomic_bool busy;
+  // alsaout_pause is waiting for the callback to return
+  atomic_bool waiting;
+  pthread_mutex_t wait_mutex;
+  pthread_cond_t wait_cond;
+  bool wait_valid;
+  // render directly into the device buffer
+  bool mmap;
   bool thread_valid;
   pthread_t alsa_thread;
   int16_t buf[BUF_FRAMES*2];
 };
 
+// returns false when paused
+static bool alsaout_render(struct alsaout_state *as,
+                           int16_t *buf, unsigned frames) {
+  // seq_cst: paired with the store to paused and the load of busy
+  // in alsaout_pause
+  atomic_store(&as->busy, true);
+  bool paused = atomic_load(&as->paused);
+  if (!paused) as->cbfunc(as->userptr, buf, frames);
+  atomic_store(&as->busy, false);
+  // the mutex is only taken when someone is actually waiting
+  if (atomic_load(&as->waiting)) {
+    pthread_mutex_lock(&as->wait_mutex);
+    pthread_cond_broadcast(&as->wait_cond);
+    pthread_mutex_unlock(&as->wait_mutex);
+  }
+  return !paused;
+}
+
+static void alsaout_write_mmap(struct alsaout_state *as,
+                               snd_pcm_sframes_t frames) {
+  while (frames > 0) {
+    if (snd_pcm_state(as->apcm) == SND_PCM_STATE_XRUN) {
+      snd_pcm_prepare(as->apcm);
+    }
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset;
+    snd_pcm_uframes_t mframes = frames;
+    if (snd_pcm_mmap_begin(as->apcm, &areas, &offset, &mframes) < 0) {
+      snd_pcm_prepare(as->apcm);
+      return;
+    }
+    if (!mframes) return;
+    // interleaved, both channels in areas[0]
+    int16_t *buf = (int16_t *)((uint8_t *)areas[0].addr +
+                               (areas[0].first + offset * areas[0].step) / 8);
+    bool rendered = alsaout_render(as, buf, mframes);
+    snd_pcm_sframes_t committed =
+      snd_pcm_mmap_commit(as->apcm, offset, rendered ? mframes : 0);
+    if (!rendered) return;
+    if (committed < 0 || (snd_pcm_uframes_t)committed != mframes) {
+      snd_pcm_prepare(as->apcm);
+      return;
+    }
+    frames -= mframes;
+  }
+}
+
+static void alsaout_write_rw(struct alsaout_state *as,
+                             snd_pcm_sframes_t frames) {
+  while (frames) {
+    snd_pcm_sframes_t genframes = frames;
+    if (genframes > BUF_FRAMES) genframes = BUF_FRAMES;
+    if (!alsaout_render(as, as->buf, genframes)) break;
+    frames -= genframes;
+    if (snd_pcm_state(as->apcm) == SND_PCM_STATE_XRUN) {
+      snd_pcm_prepare(as->apcm);
+    }
+    snd_pcm_sframes_t written = snd_pcm_writei(as->apcm, as->buf, genframes);
+    if (written < 0) {
+      snd_pcm_prepare(as->apcm);
+    }
+  }
+}
+
 static void *alsaout_thread(void *ptr) {
   struct alsaout_state *as = ptr;
   for (;;) {
@@ -55,25 +127,10 @@ static void *alsaout_thread(void *ptr) {
     if (!event) continue;
     snd_pcm_sframes_t frames = snd_pcm_avail_update(as->apcm);
     if (frames <= 0) continue;
-    while (frames) {
-      snd_pcm_sframes_t genframes = frames;
-      if (genframes > BUF_FRAMES) genframes = BUF_FRAMES;
-      while (atomic_flag_test_and_set_explicit(
-          &as->cb_flag, memory_order_acquire));
-      if (as->paused) {
-        atomic_flag_clear_explicit(&as->cb_flag, memory_order_release);
-        break;
-      }
-      as->cbfunc(as->userptr, as->buf, genframes);
-      atomic_flag_clear_explicit(&as->cb_flag, memory_order_release);
-      frames -= genframes;
-      if (snd_pcm_state(as->apcm) == SND_PCM_STATE_XRUN) {
-        err = snd_pcm_prepare(as->apcm);
-      }
-      snd_pcm_sframes_t written = snd_pcm_writei(as->apcm, as->buf, genframes);
-      if (written < 0) {
-        snd_pcm_prepare(as->apcm);
-      }
+    if (as->mmap) {
+      alsaout_write_mmap(as, frames);
+    } else {
+      alsaout_write_rw(as, frames);
     }
   }
 }
@@ -81,7 +138,7 @@ static void *alsaout_thread(void *ptr) {
 static void alsaout_pause(struct sound_state *ss, int pause, int flush) {
   struct alsaout_state *as = (struct alsaout_state *)ss;
   
-  as->paused = pause;
+  atomic_store(&as->paused, pause);
   if (!pause && flush) {
     snd_pcm_drop(as->apcm);
     snd_pcm_prepare(as->apcm);
@@ -89,9 +146,14 @@ static void alsaout_pause(struct sound_state *ss, int pause, int flush) {
   } else {
     snd_pcm_pause(as->apcm, pause);
   }
-  while (atomic_flag_test_and_set_explicit(
-      &as->cb_flag, memory_order_acquire));
-  atomic_flag_clear_explicit(&as->cb_flag, memory_order_release);
+  // wait until a callback that started before paused was set returns
+  pthread_mutex_lock(&as->wait_mutex);
+  atomic_store(&as->waiting, true);
+  while (atomic_load(&as->busy)) {
+    pthread_cond_wait(&as->wait_cond, &as->wait_mutex);
+  }
+  atomic_store(&as->waiting, false);
+  pthread_mutex_unlock(&as->wait_mutex);
   uint64_t event = 1;
   ssize_t t = write(as->fd_event, &event, sizeof(event));
   (void)t;
@@ -111,6 +173,10 @@ static void alsaout_free(struct sound_state *ss) {
     close(as->fd_event);
   }
   if (as->fds) free(as->fds);
+  if (as->wait_valid) {
+    pthread_cond_destroy(&as->wait_cond);
+    pthread_mutex_destroy(&as->wait_mutex);
+  }
   if (as->apcm) {
     snd_pcm_close(as->apcm);
   }
@@ -132,9 +198,14 @@ struct sound_state *alsaout_init(
     .cbfunc = cbfunc,
     .userptr = userptr,
     .fd_event = -1,
-    .cb_flag = ATOMIC_FLAG_INIT,
     .paused = true,
   };
+  if (pthread_mutex_init(&as->wait_mutex, 0)) goto err;
+  if (pthread_cond_init(&as->wait_cond, 0)) {
+    pthread_mutex_destroy(&as->wait_mutex);
+    goto err;
+  }
+  as->wait_valid = true;
   if (snd_pcm_open(&as->apcm, "default", SND_PCM_STREAM_PLAYBACK, 0)) {
     goto err;
   }
@@ -143,7 +214,12 @@ struct sound_state *alsaout_init(
   as->fds_space = snd_pcm_poll_descriptors_count(as->apcm) + 1;
   as->fds = malloc(sizeof(*as->fds) * as->fds_space);
   if (!as->fds) goto err;
-  if (snd_pcm_set_params(
+  // fall back to writei when the device cannot be mapped
+  as->mmap = !snd_pcm_set_params(
+      as->apcm,
+      SND_PCM_FORMAT_S16, SND_PCM_ACCESS_MMAP_INTERLEAVED, 2, srate, 1,
+      1000*1000/60);
+  if (!as->mmap && snd_pcm_set_params(
       as->apcm,
       SND_PCM_FORMAT_S16, SND_PCM_ACCESS_RW_INTERLEAVED, 2, srate, 1,
       1000*1000/60)) {
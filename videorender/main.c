@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "common/fmplayer_file.h"
+#include "common/fmplayer_common.h"
+#include "common/fmplayer_fontrom.h"
+#include "fmdriver/fmdriver.h"
+#include "fmdriver/ppz8.h"
+#include "libopna/opna.h"
+#include "libopna/opnatimer.h"
+#include "oscillo/oscillo.h"
+#include "pacc/pacc-sw.h"
+#include "fmdsp/fmdsp-pacc.h"
+#include "fmdsp/font.h"
+#include "fft/fft.h"
+
+enum {
+  SRATE = 55467,
+  FRAME_W = PC98_W,
+  FRAME_H = PC98_H,
+  // frames being rasterized or waiting for output, per worker
+  SLOTS_PER_WORKER = 3,
+  MAX_WORKERS = 64,
+  // stop when the song does not end nor loop
+  MAX_SECONDS = 30*60,
+  // oscilloscope view, same as the win32 oscilloview
+  VIEW_TRACKS = 9,
+  VIEW_SAMPLES = 1024,
+};
+
+enum {
+  OSC_BG,
+  OSC_LINE,
+  OSC_BORDER,
+};
+
+enum slot_state {
+  SLOT_FREE,
+  SLOT_QUEUED,
+  SLOT_DONE,
+};
+
+struct slot {
+  enum slot_state state;
+  // fmdsp: composed by the synthesis thread
+  // oscilloscope: drawn by the worker
+  uint8_t *index;
+  uint8_t palette[256*3];
+  struct oscillodata oscillo[VIEW_TRACKS];
+  // FRAME_W*FRAME_H*3, packed RGB or Y, Cb, Cr planes
+  uint8_t *out;
+};
+
+static struct {
+  bool oscillo;
+  bool ppm;
+  struct slot *slots;
+  unsigned slot_cnt;
+  // frames handed to the workers
+  uint64_t queued;
+  // frames a worker has started on
+  uint64_t taken;
+  bool quit;
+  pthread_mutex_t mutex;
+  // workers wait for queued frames
+  pthread_cond_t work_cond;
+  // synthesis waits for a frame to be done
+  pthread_cond_t done_cond;
+} g;
+
+static void write16le(uint8_t *ptr, uint16_t data) {
+  ptr[0] = data;
+  ptr[1] = data >> 8;
+}
+
+static void write32le(uint8_t *ptr, uint32_t data) {
+  ptr[0] = data;
+  ptr[1] = data >> 8;
+  ptr[2] = data >> 16;
+  ptr[3] = data >> 24;
+}
+
+static bool write_wave_header(FILE *file, uint32_t frames) {
+  uint8_t waveheader[44] = {0};
+  memcpy(waveheader, "RIFF", 4);
+  write32le(waveheader+4, frames * 4 + 4 + 8 + 16 + 8);
+  memcpy(waveheader+8, "WAVE", 4);
+  memcpy(waveheader+12, "fmt ", 4);
+  write32le(waveheader+16, 16);
+  write16le(waveheader+20, 1);
+  write16le(waveheader+22, 2);
+  write32le(waveheader+24, SRATE);
+  write32le(waveheader+28, SRATE * 2 * 2);
+  write16le(waveheader+32, 4);
+  write16le(waveheader+34, 16);
+  memcpy(waveheader+36, "data", 4);
+  write32le(waveheader+40, frames * 4);
+  return fwrite(waveheader, 1, sizeof(waveheader), file) == sizeof(waveheader);
+}
+
+static void oscillo_span(uint8_t *index, int x, int y0, int y1) {
+  if (y0 > y1) {
+    int t = y0;
+    y0 = y1;
+    y1 = t;
+  }
+  for (int y = y0; y <= y1; y++) {
+    index[y*FRAME_W+x] = OSC_LINE;
+  }
+}
+
+static int oscillo_y(int16_t sample, int y, int h) {
+  int sy = y + h/2 - sample * (h/2) / 16384;
+  if (sy < y) sy = y;
+  if (sy > y + h - 1) sy = y + h - 1;
+  return sy;
+}
+
+// connects the samples of each column with a vertical span
+// so peaks between pixels are not lost
+static void oscillo_draw_track(uint8_t *index, int x, int y, int w, int h,
+                               const struct oscillodata *data) {
+  int start = OSCILLO_SAMPLE_COUNT - VIEW_SAMPLES;
+  start -= (data->offset >> OSCILLO_OFFSET_SHIFT);
+  if (start < 0) start = 0;
+  int prev = oscillo_y(oscillo_sample(data, start), y, h);
+  for (int px = 0; px < w; px++) {
+    int s0 = start + px * VIEW_SAMPLES / w;
+    int s1 = start + (px + 1) * VIEW_SAMPLES / w;
+    int ymin = prev, ymax = prev;
+    for (int s = s0; s < s1; s++) {
+      int sy = oscillo_y(oscillo_sample(data, s), y, h);
+      if (sy < ymin) ymin = sy;
+      if (sy > ymax) ymax = sy;
+      prev = sy;
+    }
+    oscillo_span(index, x + px, ymin, ymax);
+  }
+}
+
+static void oscillo_draw(struct slot *s) {
+  memset(s->index, OSC_BG, FRAME_W*FRAME_H);
+  int w = FRAME_W / 3;
+  int h = FRAME_H / 3;
+  for (int x = 0; x < 3; x++) {
+    for (int y = 0; y < 3; y++) {
+      oscillo_draw_track(s->index, x*w, y*h, w, h, &s->oscillo[x*3+y]);
+    }
+  }
+  for (int i = 1; i < 3; i++) {
+    for (int y = 0; y < FRAME_H; y++) s->index[y*FRAME_W+i*w-1] = OSC_BORDER;
+    memset(s->index + (i*h-1)*FRAME_W, OSC_BORDER, FRAME_W);
+  }
+}
+
+static void oscillo_palette(uint8_t *palette) {
+  memset(palette, 0, 256*3);
+  static const uint8_t colors[][3] = {
+    [OSC_BG] = {0x00, 0x00, 0x00},
+    [OSC_LINE] = {0xff, 0xff, 0xff},
+    [OSC_BORDER] = {0x40, 0x40, 0x40},
+  };
+  memcpy(palette, colors, sizeof(colors));
+}
+
+// BT.601 limited range, through a table of the 256 palette entries
+static void convert_y4m(const struct slot *s) {
+  uint8_t ytab[256], cbtab[256], crtab[256];
+  for (int i = 0; i < 256; i++) {
+    int r = s->palette[i*3+0];
+    int gr = s->palette[i*3+1];
+    int b = s->palette[i*3+2];
+    ytab[i] = ((66*r + 129*gr + 25*b + 128) >> 8) + 16;
+    cbtab[i] = ((-38*r - 74*gr + 112*b + 128) >> 8) + 128;
+    crtab[i] = ((112*r - 94*gr - 18*b + 128) >> 8) + 128;
+  }
+  uint8_t *yp = s->out;
+  uint8_t *cbp = yp + FRAME_W*FRAME_H;
+  uint8_t *crp = cbp + FRAME_W*FRAME_H;
+  for (int i = 0; i < FRAME_W*FRAME_H; i++) {
+    uint8_t c = s->index[i];
+    yp[i] = ytab[c];
+    cbp[i] = cbtab[c];
+    crp[i] = crtab[c];
+  }
+}
+
+static void convert_ppm(const struct slot *s) {
+  for (int i = 0; i < FRAME_W*FRAME_H; i++) {
+    memcpy(s->out + i*3, s->palette + s->index[i]*3, 3);
+  }
+}
+
+static void *worker_thread(void *ptr) {
+  (void)ptr;
+  pthread_mutex_lock(&g.mutex);
+  for (;;) {
+    while (!g.quit && g.taken == g.queued) {
+      pthread_cond_wait(&g.work_cond, &g.mutex);
+    }
+    if (g.taken == g.queued) break;
+    struct slot *s = &g.slots[g.taken++ % g.slot_cnt];
+    pthread_mutex_unlock(&g.mutex);
+    if (g.oscillo) oscillo_draw(s);
+    if (g.ppm) convert_ppm(s);
+    else convert_y4m(s);
+    pthread_mutex_lock(&g.mutex);
+    s->state = SLOT_DONE;
+    pthread_cond_broadcast(&g.done_cond);
+  }
+  pthread_mutex_unlock(&g.mutex);
+  return 0;
+}
+
+// waits for the frame in the slot and writes it
+static bool slot_output(struct slot *s, FILE *file) {
+  pthread_mutex_lock(&g.mutex);
+  while (s->state != SLOT_DONE) pthread_cond_wait(&g.done_cond, &g.mutex);
+  pthread_mutex_unlock(&g.mutex);
+  bool ok;
+  if (g.ppm) {
+    ok = fprintf(file, "P6\n%d %d\n255\n", FRAME_W, FRAME_H) > 0;
+  } else {
+    ok = fputs("FRAME\n", file) >= 0;
+  }
+  ok = ok && fwrite(s->out, 1, FRAME_W*FRAME_H*3, file) == FRAME_W*FRAME_H*3;
+  s->state = SLOT_FREE;
+  return ok;
+}
+
+static void help(const char *name) {
+  fprintf(stderr, "Usage: %s [options] file out\n", name);
+  fprintf(stderr, "  writes Y4M (4:4:4) video to out, - for stdout\n");
+  fprintf(stderr, "  options:\n");
+  fprintf(stderr, "  -h        show help\n");
+  fprintf(stderr, "  -o        oscilloscope view instead of FMDSP\n");
+  fprintf(stderr, "  -p        concatenated PPM images instead of Y4M\n");
+  fprintf(stderr, "  -a file   also write the audio as WAV\n");
+  fprintf(stderr, "  -f fps    frame rate (default: 60)\n");
+  fprintf(stderr, "  -n loops  length in loops (default: 2)\n");
+  fprintf(stderr, "  -l sec    length (default: until the end or the loops)\n");
+  fprintf(stderr, "  -j jobs   rasterization threads (default: CPU count)\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  int optchar;
+  const char *wavpath = 0;
+  unsigned fps = 60;
+  int loops = 2;
+  double length = -1.0;
+  long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  while ((optchar = getopt(argc, argv, "hopa:f:n:l:j:")) != -1) {
+    switch (optchar) {
+    case 'o':
+      g.oscillo = true;
+      break;
+    case 'p':
+      g.ppm = true;
+      break;
+    case 'a':
+      wavpath = optarg;
+      break;
+    case 'f':
+      fps = atoi(optarg);
+      break;
+    case 'n':
+      loops = atoi(optarg);
+      break;
+    case 'l':
+      length = atof(optarg);
+      break;
+    case 'j':
+      jobs = atol(optarg);
+      break;
+    default:
+    case 'h':
+      help(argv[0]);
+      break;
+    }
+  }
+  if (argc != optind + 2 || !fps || fps > SRATE || loops < 1 || loops > 0xfe) {
+    fprintf(stderr, "invalid arguments\n");
+    help(argv[0]);
+  }
+  if (jobs < 1) jobs = 1;
+  if (jobs > MAX_WORKERS) jobs = MAX_WORKERS;
+
+  static struct opna opna;
+  static struct opna_timer timer;
+  static struct fmdriver_work work;
+  static struct ppz8 ppz8;
+  static uint8_t adpcm_ram[OPNA_ADPCM_RAM_SIZE];
+  static struct fmplayer_fft_input_data fftin;
+  static struct oscillodata oscillo[LIBOPNA_OSCILLO_TRACK_COUNT];
+  static struct fmdsp_font font16;
+  enum fmplayer_file_error error;
+  struct fmplayer_file *fmfile = fmplayer_file_alloc(argv[optind], &error);
+  if (!fmfile) {
+    fprintf(stderr, "cannot open file: %s\n", fmplayer_file_strerror(error));
+    return 1;
+  }
+  fmplayer_init_work_opna(&work, &ppz8, &opna, &timer, adpcm_ram);
+  fmplayer_file_load(&work, fmfile, loops);
+
+  struct pacc_vtable pacc;
+  struct pacc_ctx *pc = 0;
+  struct fmdsp_pacc *fp = 0;
+  if (!g.oscillo) {
+    fft_init_table();
+    pc = pacc_init_sw(FRAME_W, FRAME_H, &pacc);
+    fp = fmdsp_pacc_alloc();
+    if (!pc || !fp || !fmdsp_pacc_init(fp, pc, &pacc)) {
+      fprintf(stderr, "cannot initialize fmdsp\n");
+      return 1;
+    }
+    fmdsp_pacc_set(fp, &work, &opna, &fftin);
+    if (fmfile->filename_sjis) {
+      fmdsp_pacc_set_filename_sjis(fp, fmfile->filename_sjis);
+    }
+    if (fmplayer_font_rom_load(&font16)) fmdsp_pacc_set_font16(fp, &font16);
+    fmdsp_pacc_update_file(fp);
+  }
+
+  FILE *file = strcmp(argv[optind+1], "-") ? fopen(argv[optind+1], "wb") : stdout;
+  if (!file) {
+    fprintf(stderr, "cannot open output file\n");
+    return 1;
+  }
+  FILE *wavfile = 0;
+  if (wavpath) {
+    wavfile = fopen(wavpath, "wb");
+    if (!wavfile || !write_wave_header(wavfile, 0)) {
+      fprintf(stderr, "cannot open audio file\n");
+      return 1;
+    }
+  }
+
+  g.slot_cnt = jobs * SLOTS_PER_WORKER;
+  g.slots = calloc(g.slot_cnt, sizeof(*g.slots));
+  if (!g.slots) goto err_mem;
+  for (unsigned i = 0; i < g.slot_cnt; i++) {
+    g.slots[i].index = malloc(FRAME_W*FRAME_H);
+    g.slots[i].out = malloc(FRAME_W*FRAME_H*3);
+    if (!g.slots[i].index || !g.slots[i].out) goto err_mem;
+    if (g.oscillo) oscillo_palette(g.slots[i].palette);
+  }
+  pthread_mutex_init(&g.mutex, 0);
+  pthread_cond_init(&g.work_cond, 0);
+  pthread_cond_init(&g.done_cond, 0);
+  pthread_t workers[MAX_WORKERS];
+  for (long i = 0; i < jobs; i++) {
+    if (pthread_create(&workers[i], 0, worker_thread, 0)) {
+      fprintf(stderr, "cannot create worker thread\n");
+      return 1;
+    }
+  }
+
+  bool ok;
+  if (g.ppm) {
+    ok = true;
+  } else {
+    ok = fprintf(file, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C444\n",
+                 FRAME_W, FRAME_H, fps) > 0;
+  }
+  uint64_t maxframes = length >= 0.0 ? (uint64_t)(length * fps) :
+                       (uint64_t)MAX_SECONDS * fps;
+  uint64_t samples = 0;
+  uint64_t frame;
+  int16_t *buf = malloc((SRATE / fps + 1) * 4);
+  if (!buf) goto err_mem;
+  for (frame = 0; ok && frame < maxframes; frame++) {
+    if (length < 0.0 &&
+        (work.loop_cnt == 0xff || work.loop_cnt >= loops)) break;
+    struct slot *s = &g.slots[frame % g.slot_cnt];
+    // the previous frame in this slot goes out first, in order
+    if (frame >= g.slot_cnt) ok = slot_output(s, file);
+    unsigned n = (frame + 1) * SRATE / fps - samples;
+    memset(buf, 0, n * 4);
+    opna_timer_mix_oscillo(&timer, buf, n, g.oscillo ? oscillo : 0);
+    samples += n;
+    if (wavfile) ok = ok && fwrite(buf, 4, n, wavfile) == n;
+    if (g.oscillo) {
+      memcpy(s->oscillo, oscillo, sizeof(s->oscillo));
+    } else {
+      fft_write(&fftin.fdata, buf, n);
+      fmdsp_pacc_render(fp);
+      memcpy(s->index, pacc_sw_framebuffer(pc), FRAME_W*FRAME_H);
+      memcpy(s->palette, pacc_sw_palette(pc), 256*3);
+    }
+    pthread_mutex_lock(&g.mutex);
+    s->state = SLOT_QUEUED;
+    g.queued++;
+    pthread_cond_signal(&g.work_cond);
+    pthread_mutex_unlock(&g.mutex);
+  }
+  uint64_t first = frame > g.slot_cnt ? frame - g.slot_cnt : 0;
+  for (uint64_t f = first; f < frame; f++) {
+    ok = slot_output(&g.slots[f % g.slot_cnt], file) && ok;
+  }
+  pthread_mutex_lock(&g.mutex);
+  g.quit = true;
+  pthread_cond_broadcast(&g.work_cond);
+  pthread_mutex_unlock(&g.mutex);
+  for (long i = 0; i < jobs; i++) pthread_join(workers[i], 0);
+
+  if (file != stdout) ok = !fclose(file) && ok;
+  else ok = !fflush(file) && ok;
+  if (wavfile) {
+    if (samples > ((UINT32_MAX - 44) / 4)) samples = (UINT32_MAX - 44) / 4;
+    ok = !fseek(wavfile, 0, SEEK_SET) && write_wave_header(wavfile, samples) && ok;
+    ok = !fclose(wavfile) && ok;
+  }
+  if (fp) {
+    fmdsp_pacc_deinit(fp);
+    fmdsp_pacc_release(fp);
+    pacc.pacc_delete(pc);
+  }
+  fmplayer_file_free(fmfile);
+  if (!ok) {
+    fprintf(stderr, "cannot write output file\n");
+    return 1;
+  }
+  fprintf(stderr, "%llu frames\n", (unsigned long long)frame);
+  return 0;
+err_mem:
+  fprintf(stderr, "cannot allocate frame buffers\n");
+  return 1;
+}
@@ -21,6 +21,7 @@ LIBOPNA_OBJS=opna \
 	opnadrum \
 	opnaadpcm
 FMDSP_OBJS=fmdsp-pacc \
+	fmplayer_snapshot \
 	pacc-d3d9 \
 	fmdsp_platform_win \
 	font_fmdsp_small
@@ -46,6 +47,7 @@ OBJBASE=stdatomic \
 	fmplayer_fontrom_win \
 	font_rom \
 	fmplayer_work_opna \
+	fmplayer_seq \
 	about \
 	$(FMDRIVER_OBJS) \
 	$(LIBOPNA_OBJS) \
@@ -72,6 +74,7 @@ OBJBASE=main \
 	fmplayer_fontrom_win \
 	font_rom \
 	fmplayer_work_opna \
+	fmplayer_seq \
 	about \
 	$(FMDRIVER_OBJS) \
 	$(LIBOPNA_OBJS) \
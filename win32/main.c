@@ -10,11 +10,6 @@
 #else
 #include <cpuid.h> // __get_cpuid
 #endif
-#if defined(_MSC_VER) && !defined(__cplusplus)
-#include "stdatomic.h"
-#else
-#include <stdatomic.h>
-#endif
 
 #include "fmdriver/fmdriver_fmp.h"
 #include "fmdriver/fmdriver_pmd.h"
@@ -30,6 +25,7 @@
 #include "common/fmplayer_common.h"
 #include "common/fmplayer_drumrom.h"
 #include "common/fmplayer_fontrom.h"
+#include "common/fmplayer_triple.h"
 #include "wavesave.h"
 #include "fft/fft.h"
 #include "configdialog.h"
@@ -87,42 +83,32 @@ static struct {
   bool fmdsp_2x;
   struct oscillodata oscillodata_audiothread[LIBOPNA_OSCILLO_TRACK_COUNT];
   bool drum_loaded;
-  atomic_flag at_fftdata_flag;
+  // fft ring, only touched by the audio thread
   struct fmplayer_fft_data at_fftdata;
+  // copies of at_fftdata handed to the display
+  struct fmplayer_fft_data at_fftdata_pub[3];
+  struct fmplayer_triple at_fftdata_triple;
   struct fmplayer_fft_input_data fftdata;
-  atomic_flag opna_flag;
   struct pacc_ctx *pc;
   struct pacc_vtable pacc;
   struct pacc_win_vtable pacc_win;
   struct fmdsp_pacc *fp;
-} g = {
-  .at_fftdata_flag = ATOMIC_FLAG_INIT,
-  .opna_flag = ATOMIC_FLAG_INIT,
-};
+} g;
 
 HWND g_currentdlg;
 
 static void sound_cb(void *p, int16_t *buf, unsigned frames) {
   struct opna_timer *timer = (struct opna_timer *)p;
   ZeroMemory(buf, sizeof(int16_t)*frames*2);
-  while (atomic_flag_test_and_set_explicit(&g.opna_flag, memory_order_acquire));
   opna_timer_mix_oscillo(timer, buf, frames, g.oscillodata_audiothread);
-  atomic_flag_clear_explicit(&g.opna_flag, memory_order_release);
-  if (!atomic_flag_test_and_set_explicit(
-      &toneview_g.flag, memory_order_acquire)) {
-    tonedata_from_opna(&toneview_g.tonedata, &g.opna);
-    atomic_flag_clear_explicit(&toneview_g.flag, memory_order_release);
-  }
-  if (!atomic_flag_test_and_set_explicit(
-    &oscilloview_g.flag, memory_order_acquire)) {
-    memcpy(oscilloview_g.oscillodata, g.oscillodata_audiothread, sizeof(oscilloview_g.oscillodata));
-    atomic_flag_clear_explicit(&oscilloview_g.flag, memory_order_release);
-  }
-  if (!atomic_flag_test_and_set_explicit(
-    &g.at_fftdata_flag, memory_order_acquire)) {
-    fft_write(&g.at_fftdata, buf, frames);
-    atomic_flag_clear_explicit(&g.at_fftdata_flag, memory_order_release);
-  }
+  tonedata_from_opna(&toneview_g.tonedata[toneview_g.triple.back], &g.opna);
+  fmplayer_triple_publish(&toneview_g.triple);
+  memcpy(oscilloview_g.oscillodata[oscilloview_g.triple.back],
+         g.oscillodata_audiothread, sizeof(g.oscillodata_audiothread));
+  fmplayer_triple_publish(&oscilloview_g.triple);
+  fft_write(&g.at_fftdata, buf, frames);
+  g.at_fftdata_pub[g.at_fftdata_triple.back] = g.at_fftdata;
+  fmplayer_triple_publish(&g.at_fftdata_triple);
 }
 
 static void openfile(HWND hwnd, const wchar_t *path) {
@@ -569,13 +555,15 @@ static void configdialog_close_cb(void *ptr) {
 
 static void configdialog_change_cb(void *ptr) {
   (void)ptr;
-  while (atomic_flag_test_and_set_explicit(&g.opna_flag, memory_order_acquire));
+  // the callback mixes from g.opna, stop it while the settings change
+  bool playing = g.sound && !g.paused;
+  if (playing) g.sound->pause(g.sound, 1);
   opna_ssg_set_mix(&g.opna.ssg, fmplayer_config.ssg_mix);
   opna_ssg_set_ymf288(&g.opna.ssg, &g.opna.resampler, fmplayer_config.ssg_ymf288);
   ppz8_set_interpolation(&g.ppz8, fmplayer_config.ppz8_interp);
   opna_fm_set_hires_sin(&g.opna.fm, fmplayer_config.fm_hires_sin);
   opna_fm_set_hires_env(&g.opna.fm, fmplayer_config.fm_hires_env);
-  atomic_flag_clear_explicit(&g.opna_flag, memory_order_release);
+  if (playing) g.sound->pause(g.sound, 0);
 }
 
 static void on_command(HWND hwnd, int id, HWND hwnd_c, UINT code) {
@@ -700,11 +688,9 @@ static void on_activate(HWND hwnd, bool activate, HWND targetwnd, bool state) {
 
 static void render_cb(void *ptr) {
   (void)ptr;
-  if (!atomic_flag_test_and_set_explicit(
-        &g.at_fftdata_flag, memory_order_acquire)) {
-    memcpy(&g.fftdata.fdata, &g.at_fftdata, sizeof(g.fftdata.fdata));
-    atomic_flag_clear_explicit(&g.at_fftdata_flag, memory_order_release);
-  }
+  bool fresh;
+  unsigned front = fmplayer_triple_read(&g.at_fftdata_triple, &fresh);
+  if (fresh) g.fftdata.fdata = g.at_fftdata_pub[front];
   fmdsp_pacc_render(g.fp);
 }
 
@@ -789,6 +775,9 @@ int CALLBACK wWinMain(HINSTANCE hinst, HINSTANCE hpinst,
 #endif
 
   fft_init_table();
+  fmplayer_triple_init(&g.at_fftdata_triple);
+  fmplayer_triple_init(&toneview_g.triple);
+  fmplayer_triple_init(&oscilloview_g.triple);
   about_set_fontrom_loaded(fmplayer_font_rom_load(&g.font));
 
   const wchar_t *argfile = 0;
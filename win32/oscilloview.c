@@ -19,9 +19,7 @@ enum {
   IDM_NAME_FONT,
 };
 
-struct oscilloview oscilloview_g = {
-  .flag = ATOMIC_FLAG_INIT
-};
+struct oscilloview oscilloview_g;
 
 enum {
   VIEW_SAMPLES = 1024,
@@ -124,12 +122,12 @@ static void on_destroy(HWND hwnd) {
 
 static void on_timer(HWND hwnd, UINT id) {
   if (id == TIMER_UPDATE) {
-    if (!atomic_flag_test_and_set_explicit(
-      &oscilloview_g.flag, memory_order_acquire)) {
+    bool fresh;
+    unsigned front = fmplayer_triple_read(&oscilloview_g.triple, &fresh);
+    if (fresh) {
       memcpy(g.oscillodata,
-             oscilloview_g.oscillodata,
-             sizeof(oscilloview_g.oscillodata));
-      atomic_flag_clear_explicit(&oscilloview_g.flag, memory_order_release);
+             oscilloview_g.oscillodata[front],
+             sizeof(g.oscillodata));
     }
     InvalidateRect(hwnd, NULL, FALSE);
   }
@@ -319,9 +317,9 @@ static void draw_track(HDC dc,
   int start = OSCILLO_SAMPLE_COUNT - VIEW_SAMPLES;
   start -= (data->offset >> OSCILLO_OFFSET_SHIFT);
   if (start < 0) start = 0;
-  MoveToEx(dc, x, y + h/2.0 - (data->buf[start] / 16384.0) * h/2, 0);
+  MoveToEx(dc, x, y + h/2.0 - (oscillo_sample(data, start) / 16384.0) * h/2, 0);
   for (int i = 0; i < (VIEW_SAMPLES / VIEW_SKIP); i++) {
-    LineTo(dc, (double)x + ((i)*w)/(VIEW_SAMPLES / VIEW_SKIP), y + h/2.0 - (data->buf[start + i*VIEW_SKIP] / 16384.0) * h/2);
+    LineTo(dc, (double)x + ((i)*w)/(VIEW_SAMPLES / VIEW_SKIP), y + h/2.0 - (oscillo_sample(data, start + i*VIEW_SKIP) / 16384.0) * h/2);
   }
 
   SelectObject(dc, conf->hfont);
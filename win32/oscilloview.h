@@ -3,18 +3,15 @@
 
 #include "libopna/opna.h"
 #include "oscillo/oscillo.h"
+#include "common/fmplayer_triple.h"
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
-#if defined(_MSC_VER) && !defined(__cplusplus)
-#include "stdatomic.h"
-#else
-#include <stdatomic.h>
-#endif
 
+// written by the audio thread, read by the oscilloview timer
 extern struct oscilloview {
-  atomic_flag flag;
-  struct oscillodata oscillodata[LIBOPNA_OSCILLO_TRACK_COUNT];
+  struct oscillodata oscillodata[3][LIBOPNA_OSCILLO_TRACK_COUNT];
+  struct fmplayer_triple triple;
 } oscilloview_g;
 
 void oscilloview_open(HINSTANCE hinst, HWND parent, void (*closecb)(void *ptr), void *cbptr);
@@ -20,9 +20,7 @@ enum {
   ID_LIST,
 };
 
-struct toneview_g toneview_g = {
-  .flag = ATOMIC_FLAG_INIT
-};
+struct toneview_g toneview_g;
 
 static struct {
   HINSTANCE hinst;
@@ -207,11 +205,8 @@ static bool on_create(HWND hwnd, const CREATESTRUCT *cs) {
 static void on_timer(HWND hwnd, UINT id) {
   (void)hwnd;
   if (id == TIMER_UPDATE) {
-    if (!atomic_flag_test_and_set_explicit(
-        &toneview_g.flag, memory_order_acquire)) {
-      g.tonedata = toneview_g.tonedata;
-      atomic_flag_clear_explicit(&toneview_g.flag, memory_order_release);
-    }
+    g.tonedata = toneview_g.tonedata[
+        fmplayer_triple_read(&toneview_g.triple, 0)];
     g.tonedata_n = g.tonedata;
     for (int c = 0; c < 6; c++) {
       if (g.normalize) {
@@ -2,17 +2,14 @@
 #define MYON_FMPLAYER_WIN32_TONEVIEW_H_INCLUDED
 
 #include "tonedata/tonedata.h"
-#if defined(_MSC_VER) && !defined(__cplusplus)
-#include "stdatomic.h"
-#else
-#include <stdatomic.h>
-#endif
+#include "common/fmplayer_triple.h"
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
+// written by the audio thread, read by the toneview timer
 extern struct toneview_g {
-  struct fmplayer_tonedata tonedata;
-  atomic_flag flag;
+  struct fmplayer_tonedata tonedata[3];
+  struct fmplayer_triple triple;
 } toneview_g;
 
 void toneview_open(HINSTANCE hinst, HWND parent, void (*closecb)(void *ptr), void *cbptr);
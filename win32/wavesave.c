@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include "common/fmplayer_file.h"
 #include "common/fmplayer_common.h"
+#include "common/fmplayer_seq.h"
 #include "libopna/opnatimer.h"
 #include "libopna/opna.h"
 #include "wavewrite.h"
@@ -14,15 +15,20 @@
 enum {
   SRATE = 55467,
   LOOPCNT = 2,
+  // how far the driver thread runs ahead of the synthesis
+  SEQ_AHEAD = 1<<15,
+  SEQ_FRAMES = 1<<12,
 };
 
 static struct {
   ATOM class;
+  // instances exporting songs with the same pcm data share the pages
+  struct opna_adpcm_ram_pool adpcm_pool;
+  bool adpcm_pool_init;
 } g;
 
 struct fadeout {
-  struct opna_timer *timer;
-  struct fmdriver_work *work;
+  struct fmplayer_seq *seq;
   uint64_t vol;
   uint8_t loopcnt;
 };
@@ -31,12 +37,12 @@ static bool fadeout_mix(
   struct fadeout *fadeout,
   int16_t *buf, unsigned frames
 ) {
-  opna_timer_mix(fadeout->timer, buf, frames);
+  fmplayer_seq_mix(fadeout->seq, buf, frames);
   for (unsigned i = 0; i < frames; i++) {
     int vol = fadeout->vol >> 16;
     buf[i*2+0] = (buf[i*2+0] * vol) >> 16;
     buf[i*2+1] = (buf[i*2+1] * vol) >> 16;
-    if (fadeout->work->loop_cnt >= fadeout->loopcnt) {
+    if (fadeout->seq->loop_cnt >= fadeout->loopcnt) {
       fadeout->vol = (fadeout->vol * 0xffff0000ull) >> 32;
     }
   }
@@ -48,17 +54,39 @@ struct wavesave_instance {
   struct opna_timer timer;
   struct ppz8 ppz8;
   struct fmdriver_work work;
+  struct fmplayer_seq seq;
   struct fadeout fadeout;
   struct fmplayer_file *fmfile;
   struct wavefile *wavefile;
   HWND wnd;
   HWND pbar;
   int ppos;
+  // only written before the threads start
+  uint32_t loop_timerb_cnt;
   HANDLE thread;
+  HANDLE seq_thread;
+  // set by thread_seq when it queued more frames
+  HANDLE seq_event;
+  // set by thread_write when it consumed frames
+  HANDLE write_event;
   DWORD th_exit;
-  uint8_t adpcm_ram[OPNA_ADPCM_RAM_SIZE];
+  struct opna_adpcm_ram adpcm_ram;
 };
 
+// runs the driver, the register writes are synthesized in thread_write
+static DWORD CALLBACK thread_seq(void *ptr) {
+  struct wavesave_instance *inst = ptr;
+  while (!inst->th_exit) {
+    if (fmplayer_seq_ahead(&inst->seq) >= SEQ_AHEAD
+        || !fmplayer_seq_run(&inst->seq, SEQ_FRAMES)) {
+      WaitForSingleObject(inst->write_event, INFINITE);
+      continue;
+    }
+    SetEvent(inst->seq_event);
+  }
+  return 0;
+}
+
 static DWORD CALLBACK thread_write(void *ptr) {
   struct wavesave_instance *inst = ptr;
   enum {
@@ -67,12 +95,23 @@ static DWORD CALLBACK thread_write(void *ptr) {
   int16_t buf[BUFLEN*2];
   for (;;) {
     if (inst->th_exit) return 0;
+    if (fmplayer_seq_ahead(&inst->seq) < BUFLEN) {
+      WaitForSingleObject(inst->seq_event, INFINITE);
+      continue;
+    }
     memset(buf, 0, sizeof(buf));
     bool end = !fadeout_mix(&inst->fadeout, buf, BUFLEN);
+    SetEvent(inst->write_event);
+    if (fmplayer_seq_overflowed(&inst->seq)) {
+      PostMessage(inst->wnd, WM_USER, 1, 0);
+      return 0;
+    }
     if (wavewrite_write(inst->wavefile, buf, BUFLEN) != BUFLEN) {
       break;
     }
-    int newpos = 100 * inst->work.timerb_cnt / inst->work.loop_timerb_cnt;
+    // inst->work belongs to thread_seq,
+    // the progress follows the synthesized position instead
+    int newpos = 100ull * inst->seq.timerb_cnt / inst->loop_timerb_cnt;
     if (newpos != inst->ppos) {
       inst->ppos = newpos;
       PostMessage(inst->pbar, PBM_SETPOS, newpos, 0);
@@ -99,15 +138,28 @@ static void wavesave(HWND parent,
     goto err;
   }
   *inst = (struct wavesave_instance){0};
-  fmplayer_init_work_opna(&inst->work, &inst->ppz8, &inst->opna, &inst->timer, inst->adpcm_ram);
+  inst->seq_event = CreateEvent(0, FALSE, FALSE, 0);
+  inst->write_event = CreateEvent(0, FALSE, FALSE, 0);
+  if (!inst->seq_event || !inst->write_event) {
+    MessageBox(parent, L"Cannot create event", L"Error", MB_ICONSTOP);
+    goto err;
+  }
+  opna_adpcm_ram_init(&inst->adpcm_ram);
+  fmplayer_init_work_opna(&inst->work, &inst->ppz8, &inst->opna, &inst->timer, 0);
+  opna_adpcm_set_ram_paged(&inst->opna.adpcm, &inst->adpcm_ram);
   opna_ssg_set_mix(&inst->opna.ssg, fmplayer_config.ssg_mix);
   opna_ssg_set_ymf288(&inst->opna.ssg, &inst->opna.resampler, fmplayer_config.ssg_ymf288);
   ppz8_set_interpolation(&inst->ppz8, fmplayer_config.ppz8_interp);
   opna_fm_set_hires_sin(&inst->opna.fm, fmplayer_config.fm_hires_sin);
   opna_fm_set_hires_env(&inst->opna.fm, fmplayer_config.fm_hires_env);
   fmplayer_file_load(&inst->work, fmfile, LOOPCNT);
-  inst->fadeout.timer = &inst->timer;
-  inst->fadeout.work = &inst->work;
+  opna_adpcm_ram_share(&inst->adpcm_ram, &g.adpcm_pool);
+  // nothing displays the track status
+  inst->work.status_disabled = true;
+  inst->loop_timerb_cnt = inst->work.loop_timerb_cnt;
+  if (!inst->loop_timerb_cnt) inst->loop_timerb_cnt = 1;
+  fmplayer_seq_init(&inst->seq, &inst->work, &inst->timer, &inst->ppz8);
+  inst->fadeout.seq = &inst->seq;
   inst->fadeout.vol = 1ull<<32;
   inst->fadeout.loopcnt = LOOPCNT;
   inst->fmfile = fmfile;
@@ -120,6 +172,10 @@ static void wavesave(HWND parent,
   return;
 err:
   if (wavefile) wavewrite_close(wavefile);
+  if (inst) {
+    if (inst->seq_event) CloseHandle(inst->seq_event);
+    if (inst->write_event) CloseHandle(inst->write_event);
+  }
   free(inst);
 }
 
@@ -145,6 +201,7 @@ static bool on_create(HWND hwnd, const CREATESTRUCT *cs) {
                             hwnd, 0, cs->hInstance, 0);
 
   ShowWindow(hwnd, SW_SHOW);
+  inst->seq_thread = CreateThread(0, 0, thread_seq, inst, 0, 0);
   inst->thread = CreateThread(0, 0, thread_write, inst, 0, 0);
   return true;
 }
@@ -152,9 +209,16 @@ static bool on_create(HWND hwnd, const CREATESTRUCT *cs) {
 static void on_destroy(HWND hwnd) {
   struct wavesave_instance *inst = (struct wavesave_instance *)GetWindowLongPtr(hwnd, GWLP_USERDATA);
   inst->th_exit = 1;
+  SetEvent(inst->seq_event);
+  SetEvent(inst->write_event);
   WaitForSingleObject(inst->thread, INFINITE);
+  WaitForSingleObject(inst->seq_thread, INFINITE);
+  CloseHandle(inst->seq_event);
+  CloseHandle(inst->write_event);
   fmplayer_file_free(inst->fmfile);
   wavewrite_close(inst->wavefile);
+  opna_adpcm_ram_deinit(&inst->adpcm_ram);
+  opna_adpcm_ram_pool_gc(&g.adpcm_pool);
   free(inst);
 }
 
@@ -165,6 +229,11 @@ static LRESULT CALLBACK wndproc(
   HANDLE_MSG(hwnd, WM_DESTROY, on_destroy);
   HANDLE_MSG(hwnd, WM_CREATE, on_create);
   case WM_USER:
+    // wParam: the driver events overflowed
+    if (wParam) {
+      MessageBox(hwnd, L"Driver event queue overflow, the output is incomplete",
+                 L"Error", MB_ICONSTOP);
+    }
     DestroyWindow(hwnd);
     return 0;
   }
@@ -188,6 +257,13 @@ void wavesave_dialog(HWND parent, const wchar_t *fmpath) {
       return;
     }
   }
+  if (!g.adpcm_pool_init) {
+    g.adpcm_pool_init = opna_adpcm_ram_pool_init(&g.adpcm_pool);
+    if (!g.adpcm_pool_init) {
+      MessageBox(parent, L"Cannot create wavesave pcm pool", L"Error", MB_ICONSTOP);
+      return;
+    }
+  }
   wchar_t path[MAX_PATH] = {0};
 
   OPENFILENAME ofn = {